@@ -23,6 +23,8 @@
         SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#define _GNU_SOURCE
+
 #include <strings.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -31,17 +33,80 @@
 #include <limits.h>
 #include <stdio.h>
 #include <time.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sched.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+#include <sys/utsname.h>
 
 #include "rotate.h"
 #include "triple-shift-rotate.h"
+#include "triple-shift-rotate-hybrid.h"
 
 typedef void rotate_function(uintptr_t *array, size_t left, size_t right);
+typedef void sized_rotate_function(void *array, size_t left, size_t right, size_t size);
 
 typedef struct {
 	rotate_function		*rotate;
 	char			*name;
+	bool			skip;	// Set if not selected via -a
 } rotate_function_t;
 
+typedef struct {
+	sized_rotate_function	*rotate;
+	char			*name;
+	bool			skip;	// Set if not selected via -a
+} sized_rotate_function_t;
+
+
+// The hybrid rotate() with unlimited scratch memory, and with none at all
+static void
+hybrid_rotation(uintptr_t *array, size_t left, size_t right)
+{
+	rotate(array, left, right, SIZE_MAX);
+} // hybrid_rotation
+
+
+static void
+hybrid_inplace_rotation(uintptr_t *array, size_t left, size_t right)
+{
+	rotate(array, left, right, 0);
+} // hybrid_inplace_rotation
+
+
+// The Aux rotation for items of any width, as the one in rotate.h only moves
+// uintptr_t's.  As with that one, the smaller block goes via a malloc()'d buffer
+static void
+auxiliary_rotation_sized(void *array, size_t left, size_t right, size_t size)
+{
+	char	*pa = array, *pb = pa + (left * size), *pc = pa + (right * size), *swap;
+
+	if (left < right) {
+		swap = malloc(left * size);
+		memcpy(swap, pa, left * size);
+		memmove(pa, pb, right * size);
+		memcpy(pc, swap, left * size);
+	} else {
+		swap = malloc(right * size);
+		memcpy(swap, pb, right * size);
+		memmove(pc, pa, left * size);
+		memcpy(pa, swap, right * size);
+	}
+	free(swap);
+} // auxiliary_rotation_sized
+
+
 rotate_function_t rotations[] = {
 //	{juggling_rotation,       "Juggling Rotation"},
 //	{griesmills_rotation,     "Gries-Mills Rotation"},
@@ -57,11 +122,22 @@ rotate_function_t rotations[] = {
 	{half_reverse_rotate,     "Half Reverse Rotate"},
 	{triple_shift_rotate,     "Triple Shift Rotate"},
 	{triple_shift_rotate_v2,  "Triple Shift Rotate V2"},
+	{triple_shift_rotate_v2_simd, "Triple Shift V2 SIMD"},
 	{auxiliary_rotation,      "Aux Rotation (N/2 Aux)"},
 	{bridge_rotation,         "Bridge Rotate (N/3 Aux)"},
+	{hybrid_rotation,         "Hybrid rotate()"},
+	{hybrid_inplace_rotation, "Hybrid rotate() In-Place"},
 	{NULL,                    "End Of List"}
 };
 
+// The item size generic rotations, which are run for every item width
+sized_rotate_function_t sized_rotations[] = {
+	{triple_shift_rotate_v2_sized,      "TSR V2 Sized"},
+	{triple_shift_rotate_v2_simd_sized, "TSR V2 SIMD"},
+	{auxiliary_rotation_sized,          "Aux Rotation Sized"},
+	{NULL,                              "End Of List"}
+};
+
 
 // Simple function to safely return an entry from the rotations[] table
 rotate_function_t *
@@ -80,80 +156,2828 @@ get_function(int i)
 } // get_function 
 
 
-// Feel free to exit this to set whatever sizes you want to test
+// Feel free to exit this to set whatever sizes you want to test, or give them
+// on the command line via -s
 size_t	test_steps[] = {10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000};
 //size_t	test_steps[] = {2500, 3750, 5000, 6250, 7500, 8750, 10000, 12500};
 
+// Item widths, in bytes, that the sized_rotations[] are tested with, unless
+// given via -w
+size_t	test_widths[] = {1, 2, 4, 8, 16, 24};
+
+// Record widths, in bytes, that the records mode sweeps, unless given via -w
+size_t	record_widths[] = {8, 16, 32, 64, 128, 256};
+
 #define MAX_TIME	50000000000ULL
 #define	MAX_VALS	2000000
 
-int
-main()
+#define MAX_LIST	64
+#define MAX_TRIALS	1000
+
+// How the left block sizes are chosen for each array size
+enum {
+	DIST_ALL,		// Every left size from 1 to SZ-1
+	DIST_RANDOM,		// As many left sizes again, but at random
+	DIST_RATIO,		// Always the same fraction of SZ
+	DIST_FIXED		// Always the same left size, for the corners mode
+};
+
+// Where the array being rotated is within the caches
+enum {
+	CACHE_WARM,		// The same array every time, so it stays cached
+	CACHE_COLD,		// The array is flushed from the caches every time
+	CACHE_POOL,		// At a random place in a pool far larger than LLC
+	CACHE_NUM
+};
+
+// How the results are written out
+enum {
+	FORMAT_TABLE,
+	FORMAT_CSV,
+	FORMAT_JSON
+};
+
+// The benchmark options, as set from the command line
+static struct {
+	size_t	sizes[MAX_LIST];	// Array sizes to test, in items
+	size_t	nsizes;
+	size_t	widths[MAX_LIST];	// Item widths for the sized_rotations[]
+	size_t	nwidths;
+	double	budget;			// Seconds per test, or 0 for test_loops()
+	int	dist;			// One of DIST_*
+	double	ratio;			// Left size fraction for DIST_RATIO
+	size_t	left;			// Left size for DIST_FIXED
+	int	format;			// One of FORMAT_*
+	char	*mode;			// Name of the test mode being run
+	size_t	trials;			// Timed trials that each test is split into
+	double	warmup;			// Seconds of untimed rotations before each test
+	bool	shuffle;		// Run the algorithms in a random order
+	char	*cpus;			// CPUs that we're pinned to, as given via -c
+	bool	counters;		// Read the hardware performance counters
+	size_t	steps;			// Left/N ratios that the heatmap is cut into
+	int	caches[CACHE_NUM];	// The cache modes to test, each in turn
+	size_t	ncaches;
+	size_t	pool_mb;		// Size of the CACHE_POOL pool, or 0 for auto
+	bool	roofline;		// Measure the bandwidth baselines at each size
+	size_t	file_mb;		// Size of the file that the file mode rotates
+} opt = {
+	.dist = DIST_ALL,
+	.format = FORMAT_TABLE,
+	.mode = "rotate",
+	.trials = 5,
+	.warmup = 0.02,
+	.cpus = "all",
+	.steps = 32,
+	.caches = {CACHE_WARM},
+	.ncaches = 1,
+	.file_mb = 256,
+};
+
+// The hardware performance counters that -p reads
+enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_NUM
+};
+
+// The bandwidth baselines that -b measures, as the ceiling for the rotations
+enum {
+	ROOF_MEMCPY,
+	ROOF_MEMMOVE,
+	ROOF_TRIAD,
+	ROOF_NUM
+};
+
+// The spread of the times per rotation over all of the trials of one test
+typedef struct {
+	double	median;
+	double	min;
+	double	p99;
+	double	mean;
+	double	ci;		// Half width of the 95% confidence interval of the mean
+	size_t	trials;
+	double	perf[PERF_NUM];	// Counts per rotation, or < 0 if not counted
+	double	roof[ROOF_NUM];	// GB/s of each baseline, or < 0 if not measured
+#ifdef TSR_COUNT_MOVES
+	double	reads;		// Bytes of traffic per rotation, or < 0 if not
+	double	writes;		// counted.  See triple-shift-rotate-moves.h
+	double	copied;
+#endif
+} stats_t;
+
+// Number of uintptr_t's that the test array holds
+static size_t	nvals = MAX_VALS;
+
+static const char *dist_names[] = {"all", "random", "ratio", "fixed"};
+
+// The scenario being run by the corners mode, for the CSV and JSON output
+static const char *report_case = "";
+
+static const char *cache_names[] = {"warm", "cold", "pool"};
+
+static const char *roof_names[] = {"memcpy", "memmove", "triad"};
+
+// The cache mode currently being tested
+static int	cache_mode = CACHE_WARM;
+
+
+//------------------------------------------------------------------------------
+//                                 Statistics
+//------------------------------------------------------------------------------
+
+static int
+cmp_double(const void *a, const void *b)
 {
-	struct	timespec start, end;
-	uintptr_t *a;
+	double	x = *(const double *)a, y = *(const double *)b;
 
-	a = malloc(sizeof(*a) * MAX_VALS);
-	if (!a) {
-		printf("malloc() failure\n");
-		exit(1);
+	return (x > y) - (x < y);
+} // cmp_double
+
+
+// Returns the P'th percentile of the N sorted values in V, interpolating
+// between the two nearest values
+static double
+percentile(const double *v, size_t n, double p)
+{
+	double	pos = p * (n - 1);
+	size_t	i = (size_t)pos;
+
+	if ((i + 1) >= n)
+		return v[n - 1];
+
+	return v[i] + ((pos - i) * (v[i + 1] - v[i]));
+} // percentile
+
+
+// Works out the spread of the N times in TIMES, which get sorted.  The
+// confidence interval uses Student's t, as there are usually very few trials
+static stats_t
+stats_of(double *times, size_t n)
+{
+	static const double t95[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+	};
+	stats_t	st = { .trials = n };
+	double	sum = 0, var = 0;
+
+	for (int i = 0; i < PERF_NUM; i++)
+		st.perf[i] = -1;
+	for (int i = 0; i < ROOF_NUM; i++)
+		st.roof[i] = -1;
+#ifdef TSR_COUNT_MOVES
+	st.reads = st.writes = st.copied = -1;
+#endif
+
+	qsort(times, n, sizeof(*times), cmp_double);
+
+	for (size_t i = 0; i < n; i++)
+		sum += times[i];
+	st.mean = sum / n;
+
+	for (size_t i = 0; i < n; i++)
+		var += (times[i] - st.mean) * (times[i] - st.mean);
+
+	st.min = times[0];
+	st.median = percentile(times, n, 0.5);
+	st.p99 = percentile(times, n, 0.99);
+
+	if (n > 1) {
+		double	t = ((n - 1) <= (sizeof(t95) / sizeof(*t95))) ? t95[n - 2] : 1.960;
+
+		st.ci = t * sqrt(var / (n - 1)) / sqrt(n);
 	}
-	for (size_t i = 0; i < MAX_VALS; i++)
-		a[i] = i;
 
-	for (size_t step = 0; step < (sizeof(test_steps) / sizeof(*test_steps)); step++) {
-		size_t	SZ = test_steps[step];
+	return st;
+} // stats_of
 
-		if (SZ > MAX_VALS)
+
+//------------------------------------------------------------------------------
+//                            Hardware Counters
+//------------------------------------------------------------------------------
+
+// Each counter is opened on its own rather than as a group, so that one that
+// the CPU or kernel doesn't support (as in most VMs) doesn't stop the others
+// from being read.  The kernel is excluded, so that they work for unprivileged
+// users at the default perf_event_paranoid level
+static int	perf_fd[PERF_NUM] = {-1, -1, -1, -1, -1, -1};
+
+#define PERF_CACHE(cache, op, result) \
+	((cache) | ((op) << 8) | ((result) << 16))
+
+static const struct {
+	const char	*name;
+	uint32_t	type;
+	uint64_t	config;
+} perf_events[PERF_NUM] = {
+#ifdef __linux__
+	{"cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"l1d_misses",   PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_L1D,
+	                                                PERF_COUNT_HW_CACHE_OP_READ,
+	                                                PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"llc_misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	{"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"dtlb_misses",  PERF_TYPE_HW_CACHE, PERF_CACHE(PERF_COUNT_HW_CACHE_DTLB,
+	                                                PERF_COUNT_HW_CACHE_OP_READ,
+	                                                PERF_COUNT_HW_CACHE_RESULT_MISS)},
+#else
+	{"cycles"}, {"instructions"}, {"l1d_misses"},
+	{"llc_misses"}, {"branch_misses"}, {"dtlb_misses"},
+#endif
+};
+
+
+// Opens every counter that can be opened, and says on stderr which can't.  Returns the
+// number that were opened.  The counters stay disabled until perf_start()
+static int
+perf_open(void)
+{
+	int	nopen = 0;
+
+#ifdef __linux__
+	for (int i = 0; i < PERF_NUM; i++) {
+		struct	perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perf_events[i].type;
+		attr.config = perf_events[i].config;
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		perf_fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (perf_fd[i] < 0)
+			fprintf(stderr, "Counter %s is unavailable: %s\n", perf_events[i].name, strerror(errno));
+		else
+			nopen++;
+	}
+#else
+	fprintf(stderr, "Hardware counters are only supported on Linux\n");
+#endif
+
+	return nopen;
+} // perf_open
+
+
+static void
+perf_close(void)
+{
+	for (int i = 0; i < PERF_NUM; i++) {
+		if (perf_fd[i] >= 0)
+			close(perf_fd[i]);
+		perf_fd[i] = -1;
+	}
+} // perf_close
+
+
+// Zeroes and starts every open counter
+static void
+perf_start(void)
+{
+#ifdef __linux__
+	for (int i = 0; i < PERF_NUM; i++) {
+		if (perf_fd[i] >= 0) {
+			ioctl(perf_fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(perf_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+} // perf_start
+
+
+// Stops every open counter, and adds their counts to TOTALS.  If the kernel had
+// to share the hardware counters out, then the counts are scaled up to the
+// whole time that they were enabled
+static void
+perf_stop(double *totals)
+{
+#ifdef __linux__
+	for (int i = 0; i < PERF_NUM; i++)
+		if (perf_fd[i] >= 0)
+			ioctl(perf_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+	for (int i = 0; i < PERF_NUM; i++) {
+		uint64_t val[3];	// Count, time enabled, time running
+
+		if ((perf_fd[i] < 0) || (read(perf_fd[i], val, sizeof(val)) != sizeof(val)))
+			continue;
+
+		if ((val[2] > 0) && (val[2] < val[1]))
+			totals[i] += (double)val[0] * val[1] / val[2];
+		else
+			totals[i] += val[0];
+	}
+#endif
+} // perf_stop
+
+
+//------------------------------------------------------------------------------
+//                                 Reporting
+//------------------------------------------------------------------------------
+
+// Informational messages go to stdout with the human readable table, but must
+// be kept out of the way of CSV and JSON output
+static void
+info(const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	vfprintf((opt.format == FORMAT_TABLE) ? stdout : stderr, fmt, ap);
+	va_end(ap);
+} // info
+
+
+// Writes STR out as a JSON string
+static void
+json_string(const char *str)
+{
+	putchar('"');
+	for ( ; *str; str++) {
+		if ((*str == '"') || (*str == '\\'))
+			putchar('\\');
+		if ((unsigned char)*str >= ' ')
+			putchar(*str);
+	}
+	putchar('"');
+} // json_string
+
+
+// Returns the CPU model name, or "unknown" if it can't be found
+static const char *
+cpu_model(void)
+{
+	static char model[256] = "unknown";
+	char	line[512], *p;
+	FILE	*fp;
+
+	fp = fopen("/proc/cpuinfo", "r");
+	if (!fp)
+		return model;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "model name", 10) || !(p = strchr(line, ':')))
 			continue;
 
+		for (p++; *p == ' '; p++);
+		p[strcspn(p, "\n")] = '\0';
+		snprintf(model, sizeof(model), "%s", p);
+		break;
+	}
+	fclose(fp);
+
+	return model;
+} // cpu_model
+
+
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS	"unknown"
+#endif
+
+#ifdef TSR_CONFIG
+#define BUILD_CONFIG	TSR_CONFIG
+#else
+#define BUILD_CONFIG	"none"
+#endif
+
+#ifdef TSR_COUNT_MOVES
+#define BUILD_MOVES	"on"
+#else
+#define BUILD_MOVES	"off"
+#endif
+
+// Writes out the metadata that describes this run.  CSV gets it as comments
+// ahead of the column names, and JSON as the "meta" object
+static void
+report_begin(void)
+{
+	struct	utsname uts;
+	char	date[64], os[256], stream[32], trials[32], warmup[32], caches[32] = "";
+	time_t	now = time(NULL);
+
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	if (uname(&uts) == 0)
+		snprintf(os, sizeof(os), "%s %s %s", uts.sysname, uts.release, uts.machine);
+	else
+		snprintf(os, sizeof(os), "unknown");
+#ifdef TSR_TUNABLE
+	snprintf(stream, sizeof(stream), "%zu", tsr_tune.min_stream_size);
+#else
+	snprintf(stream, sizeof(stream), "%d", TSR_MIN_STREAM_SIZE);
+#endif
+	snprintf(trials, sizeof(trials), "%zu", opt.trials);
+	snprintf(warmup, sizeof(warmup), "%g", opt.warmup);
+	for (size_t c = 0; c < opt.ncaches; c++) {
+		if (c > 0)
+			strcat(caches, ",");
+		strcat(caches, cache_names[opt.caches[c]]);
+	}
+
+	const char *meta[][2] = {
+		{"date",            date},
+		{"cpu",             cpu_model()},
+		{"os",              os},
+		{"compiler",        __VERSION__},
+		{"flags",           BUILD_FLAGS},
+		{"config",          BUILD_CONFIG},
+		{"simd",            tsr_simd->name},
+		{"min_stream_size", stream},
+		{"mode",            opt.mode},
+		{"distribution",    dist_names[opt.dist]},
+		{"trials",          trials},
+		{"warmup",          warmup},
+		{"order",           opt.shuffle ? "random" : "fixed"},
+		{"caches",          caches},
+		{"affinity",        opt.cpus},
+		{"counters",        opt.counters ? "on" : "off"},
+		{"roofline",        opt.roofline ? "on" : "off"},
+		{"move_counting",   BUILD_MOVES},
+	};
+	size_t	nmeta = sizeof(meta) / sizeof(*meta);
+
+	switch (opt.format) {
+	case FORMAT_TABLE:
+		printf("SIMD kernels in use: %s\n", tsr_simd->name);
+		break;
+	case FORMAT_CSV:
+		for (size_t i = 0; i < nmeta; i++)
+			printf("# %s: %s\n", meta[i][0], meta[i][1]);
+		printf("# cpus: %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+		if (opt.dist == DIST_RATIO)
+			printf("# ratio: %g\n", opt.ratio);
+		printf("mode,cache,case,name,items,width,ns,gbps,min,p99,mean,ci95,trials");
+		for (int i = 0; opt.counters && (i < PERF_NUM); i++)
+			printf(",%s,%s_per_item", perf_events[i].name, perf_events[i].name);
+#ifdef TSR_COUNT_MOVES
+		printf(",read_bytes,written_bytes,copied_bytes,traffic_vs_min");
+#endif
+		for (int i = 0; opt.roofline && (i < ROOF_NUM); i++)
+			printf(",%s_gbps", roof_names[i]);
+		if (opt.roofline)
+			printf(",traffic_gbps,roofline_pct");
 		printf("\n");
-		printf("         NAME                 ITEMS         TIME/ROTATE\n");
+		break;
+	case FORMAT_JSON:
+		printf("{\n  \"meta\": {\n");
+		for (size_t i = 0; i < nmeta; i++) {
+			printf("    ");
+			json_string(meta[i][0]);
+			printf(": ");
+			json_string(meta[i][1]);
+			printf(",\n");
+		}
+		printf("    \"cpus\": %ld", sysconf(_SC_NPROCESSORS_ONLN));
+		if (opt.dist == DIST_RATIO)
+			printf(",\n    \"ratio\": %g", opt.ratio);
+		printf("\n  },\n  \"results\": [");
+		break;
+	}
+} // report_begin
+
+
+// Starts a new table of results.  ITEMS and TIME are the column titles, which
+// only the human readable table has.  The 95% confidence interval of the mean
+// is shown as a percentage of the median when there is more than one trial
+static void
+report_header(const char *items, const char *time)
+{
+	if (opt.format != FORMAT_TABLE)
+		return;
+
+	printf("\n");
+	if (opt.trials > 1) {
+		printf("         NAME               %7s     %15s     95%% CI\n", items, time);
+		printf("==================================================================\n");
+	} else {
+		printf("         NAME               %7s     %15s\n", items, time);
 		printf("=======================================================\n");
+	}
+} // report_header
 
-		for (int fno = 0; ; fno++) {
-			rotate_function_t *f = get_function(fno);
-			if (f == NULL)
-				break;
 
-			// Determine the number of loops we will do
-			size_t	stop = MAX_TIME / (SZ * SZ);
+// Writes out the hardware counts per operation of ST in the table, with each
+// counter that was unavailable left out
+static void
+report_counters(const stats_t *st)
+{
+	bool	any = false;
+
+	for (int i = 0; i < PERF_NUM; i++) {
+		if (st->perf[i] < 0)
+			continue;
+
+		printf("%s %s %.2f", any ? "," : "    per op:", perf_events[i].name, st->perf[i]);
+		if ((i == PERF_INSTRUCTIONS) && (st->perf[PERF_CYCLES] > 0))
+			printf(" (IPC %.2f)", st->perf[i] / st->perf[PERF_CYCLES]);
+		any = true;
+	}
+	if (any)
+		printf("\n");
+} // report_counters
 
-			// The following applies a fudge factor to speed up the
-			// testing of very small arrays
-			size_t	div = 400 / SZ;
-			if (div < 1)
-				div = 1;
 
-			// Apply the fudge factor, and apply a minimum of 1
-			stop /= div;
-			if (stop < 1)
-				stop = 1;
+// Returns the bytes of memory traffic per operation of ST, as counted by the
+// rotate-moves build.  Otherwise it is the least that any rotation of ITEMS
+// items of WIDTH bytes can make, being one read and one write of each item
+static double
+traffic_of(const stats_t *st, size_t items, size_t width)
+{
+#ifdef TSR_COUNT_MOVES
+	if (st->reads >= 0)
+		return st->reads + st->writes + (2 * st->copied);
+#endif
+	return 2.0 * items * width;
+} // traffic_of
 
-			// Let's run this thing!
-			size_t	runs = 0;
-			clock_gettime(CLOCK_MONOTONIC, &start);
 
-			// Very large sets take a long time to do every single
-			// rotation size.  The following starts skipping sizes
-			// for tests over 100,000 elements in size
-			size_t gap = 1;
-			if (SZ > (100 * 1000))
-				gap = (SZ - 1) / (100 * 1000);
-
-			for (size_t j = 0; j < stop; j++) {
-				for (size_t i = 1; i < SZ; i += gap) {
-					f->rotate(a, i, SZ - i);
-					runs++;
-				}
+#ifdef TSR_COUNT_MOVES
+// Returns the total traffic of ST as a multiple of the least that a rotation
+// of ITEMS items of WIDTH bytes can make, being one read and one write of each
+static double
+traffic_vs_min(const stats_t *st, size_t items, size_t width)
+{
+	return traffic_of(st, items, width) / (2.0 * items * width);
+} // traffic_vs_min
+#endif
+
+
+// Returns the fastest of the baselines in ST, or 0 if none were measured
+static double
+roof_ceiling(const stats_t *st)
+{
+	double	best = 0;
+
+	for (int i = 0; i < ROOF_NUM; i++)
+		if (st->roof[i] > best)
+			best = st->roof[i];
+
+	return best;
+} // roof_ceiling
+
+
+// Writes out one result.  NAME took ST nanoseconds per operation on ITEMS
+// items, each of WIDTH bytes.  SIZED results have the width in their label.
+// The table only shows the median, while CSV and JSON get the full spread, and
+// the GB/s that the median works out to.  Any hardware counts are given per
+// operation, and per item.  With -b, the traffic per second is also given as a
+// percentage of the fastest baseline
+static void
+report(const char *name, bool sized, size_t items, size_t width, const stats_t *st)
+{
+	static bool first = true;
+	double	gbps = (st->median > 0) ? (items * width) / st->median : 0;
+	double	traffic = (st->median > 0) ? traffic_of(st, items, width) / st->median : 0;
+	double	ceiling = roof_ceiling(st);
+	double	pct = (ceiling > 0) ? (100 * traffic) / ceiling : 0;
+	char	label[64];
+
+	switch (opt.format) {
+	case FORMAT_TABLE:
+		if (sized)
+			snprintf(label, sizeof(label), "%s %zuB", name, width);
+		else
+			snprintf(label, sizeof(label), "%s", name);
+		printf("%-24s    %7lu        %10.3fns", label, items, st->median);
+		if (st->trials > 1)
+			printf("    +/-%.2f%%", (st->median > 0) ? (100 * st->ci) / st->median : 0);
+		printf("\n");
+		if (opt.counters)
+			report_counters(st);
+#ifdef TSR_COUNT_MOVES
+		if (st->reads >= 0)
+			printf("    per op: read %.0fB, written %.0fB, copied %.0fB, %.3fx the least traffic\n",
+			       st->reads, st->writes, st->copied, traffic_vs_min(st, items, width));
+#endif
+		if (ceiling > 0)
+			printf("    roofline: %.2f GB/s of traffic, %.1f%% of the %.2f GB/s ceiling"
+			       " (memcpy %.2f, memmove %.2f, triad %.2f)\n", traffic, pct, ceiling,
+			       st->roof[ROOF_MEMCPY], st->roof[ROOF_MEMMOVE], st->roof[ROOF_TRIAD]);
+		break;
+	case FORMAT_CSV:
+		printf("%s,%s,\"%s\",\"%s\",%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu", opt.mode,
+		       cache_names[cache_mode], report_case, name, items, width, st->median, gbps,
+		       st->min, st->p99, st->mean, st->ci, st->trials);
+		for (int i = 0; opt.counters && (i < PERF_NUM); i++) {
+			if (st->perf[i] < 0)
+				printf(",,");
+			else
+				printf(",%.3f,%.5f", st->perf[i], st->perf[i] / items);
+		}
+#ifdef TSR_COUNT_MOVES
+		if (st->reads < 0)
+			printf(",,,,");
+		else
+			printf(",%.1f,%.1f,%.1f,%.4f", st->reads, st->writes, st->copied,
+			       traffic_vs_min(st, items, width));
+#endif
+		if (opt.roofline) {
+			for (int i = 0; i < ROOF_NUM; i++) {
+				if (st->roof[i] < 0)
+					printf(",");
+				else
+					printf(",%.3f", st->roof[i]);
+			}
+			if (ceiling > 0)
+				printf(",%.3f,%.2f", traffic, pct);
+			else
+				printf(",,");
+		}
+		printf("\n");
+		break;
+	case FORMAT_JSON:
+		printf("%s\n    {\"mode\": ", first ? "" : ",");
+		json_string(opt.mode);
+		printf(", \"cache\": ");
+		json_string(cache_names[cache_mode]);
+		printf(", \"case\": ");
+		json_string(report_case);
+		printf(", \"name\": ");
+		json_string(name);
+		printf(", \"items\": %zu, \"width\": %zu, \"ns\": %.3f, \"gbps\": %.3f, \"min\": %.3f, "
+		       "\"p99\": %.3f, \"mean\": %.3f, \"ci95\": %.3f, \"trials\": %zu", items, width,
+		       st->median, gbps, st->min, st->p99, st->mean, st->ci, st->trials);
+		for (int i = 0; opt.counters && (i < PERF_NUM); i++) {
+			printf(", \"%s\": ", perf_events[i].name);
+			if (st->perf[i] < 0)
+				printf("null");
+			else
+				printf("{\"per_op\": %.3f, \"per_item\": %.5f}", st->perf[i], st->perf[i] / items);
+		}
+#ifdef TSR_COUNT_MOVES
+		if (st->reads < 0)
+			printf(", \"moves\": null");
+		else
+			printf(", \"moves\": {\"read_bytes\": %.1f, \"written_bytes\": %.1f, \"copied_bytes\": %.1f, "
+			       "\"traffic_vs_min\": %.4f}", st->reads, st->writes, st->copied,
+			       traffic_vs_min(st, items, width));
+#endif
+		if (opt.roofline && (ceiling <= 0)) {
+			printf(", \"roofline\": null");
+		} else if (opt.roofline) {
+			printf(", \"roofline\": {");
+			for (int i = 0; i < ROOF_NUM; i++)
+				printf("\"%s_gbps\": %.3f, ", roof_names[i], st->roof[i]);
+			printf("\"traffic_gbps\": %.3f, \"pct\": %.2f}", traffic, pct);
+		}
+		printf("}");
+		break;
+	}
+	first = false;
+	fflush(stdout);
+} // report
+
+
+static void
+report_end(void)
+{
+	if (opt.format == FORMAT_JSON)
+		printf("\n  ]\n}\n");
+} // report_end
+
+
+//------------------------------------------------------------------------------
+//                                  Timing
+//------------------------------------------------------------------------------
+
+// Returns the number of times that every rotation of an SZ item array will be
+// run for, so that each algorithm gets roughly the same amount of test time
+static size_t
+test_loops(size_t SZ)
+{
+	// Determine the number of loops we will do
+	size_t	stop = MAX_TIME / (SZ * SZ);
+
+	// The following applies a fudge factor to speed up the
+	// testing of very small arrays
+	size_t	div = 400 / SZ;
+	if (div < 1)
+		div = 1;
+
+	// Apply the fudge factor, and apply a minimum of 1
+	stop /= div;
+	if (stop < 1)
+		stop = 1;
+
+	return stop;
+} // test_loops
+
+
+// Very large sets take a long time to do every single rotation size.  This
+// returns the gap to skip sizes by for tests over 100,000 elements in size
+static size_t
+test_gap(size_t SZ)
+{
+	size_t gap = 1;
+
+	if (SZ > (100 * 1000))
+		gap = (SZ - 1) / (100 * 1000);
+
+	return gap;
+} // test_gap
+
+
+// Fills in the left block sizes that will be rotated for an SZ item array, as
+// per the chosen distribution.  The returned array must be free()'d.  *LOOPS
+// is set so that the same number of rotations are run as for DIST_ALL
+static size_t *
+test_lefts(size_t SZ, size_t *nlefts, size_t *loops)
+{
+	size_t	gap = test_gap(SZ), count = (SZ - 1 + gap - 1) / gap, *lefts;
+
+	*loops = test_loops(SZ);
+
+	if ((opt.dist == DIST_RATIO) || (opt.dist == DIST_FIXED)) {
+		size_t	left = (opt.dist == DIST_FIXED) ? opt.left : (size_t)(SZ * opt.ratio);
+
+		// Run just the one left size, as often as all of the others
+		*loops *= count;
+		count = 1;
+		if (left < 1)
+			left = 1;
+		if (left > (SZ - 1))
+			left = SZ - 1;
+
+		lefts = malloc(sizeof(*lefts));
+		if (lefts)
+			lefts[0] = left;
+	} else {
+		lefts = malloc(sizeof(*lefts) * count);
+		if (lefts) {
+			srand(SZ);
+			for (size_t i = 0; i < count; i++) {
+				if (opt.dist == DIST_RANDOM)
+					lefts[i] = 1 + (rand() % (SZ - 1));
+				else
+					lefts[i] = 1 + (i * gap);
+			}
+		}
+	}
+
+	if (!lefts) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	*nlefts = count;
+	return lefts;
+} // test_lefts
+
+
+// Returns the nanoseconds elapsed since START
+static double
+elapsed(const struct timespec *start)
+{
+	struct	timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((now.tv_sec - start->tv_sec) * 1000000000.0) + (now.tv_nsec - start->tv_nsec);
+} // elapsed
+
+
+// Number of random places in the pool that the CACHE_POOL rotations cycle
+// through.  Must be a power of 2
+#define POOL_PLACES	4096
+
+// The pool must be at least this many times the size of the LLC, and of the
+// largest rotation
+#define POOL_FACTOR	4
+
+// The CACHE_COLD rotations are timed one at a time, with the whole array being
+// flushed before each.  That costs far more than the rotations, so at most this
+// many are run for each trial
+#define COLD_SAMPLES	256
+
+static char	*pool;
+static size_t	pool_size;
+static size_t	pool_places[POOL_PLACES];
+
+// Time that a clock_gettime() pair takes, which is taken off of the time of
+// each rotation done on its own
+static double	clock_overhead;
+
+
+// Sets up for the cache modes in opt.caches.  MAX_BYTES is the size of the
+// largest rotation that will be run
+static void
+cache_init(size_t max_bytes)
+{
+	struct	timespec start;
+
+	for (int i = 0; i < 1000; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		double	tim = elapsed(&start);
+
+		if ((i == 0) || (tim < clock_overhead))
+			clock_overhead = tim;
+	}
+
+	for (size_t c = 0; c < opt.ncaches; c++) {
+		if (opt.caches[c] != CACHE_POOL)
+			continue;
+
+		if (opt.pool_mb > 0) {
+			pool_size = opt.pool_mb << 20;
+		} else {
+			long	llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+			if (llc <= 0)
+				llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+			if (llc <= 0)
+				llc = 32 << 20;
+			pool_size = POOL_FACTOR * llc;
+		}
+		if (pool_size < (POOL_FACTOR * max_bytes))
+			pool_size = POOL_FACTOR * max_bytes;
+
+		pool = malloc(pool_size);
+		if (!pool) {
+			printf("malloc() failure\n");
+			exit(1);
+		}
+		memset(pool, 0, pool_size);
+	}
+} // cache_init
+
+
+static void
+cache_free(void)
+{
+	free(pool);
+	pool = NULL;
+} // cache_free
+
+
+// Picks the random places in the pool for rotations of BYTES bytes.  They are
+// kept cache line aligned, so as to keep the alignment of the test array
+static void
+pool_place(size_t bytes)
+{
+	size_t	lines = (pool_size - bytes) / 64;
+	unsigned int seed = bytes;
+
+	for (size_t i = 0; i < POOL_PLACES; i++)
+		pool_places[i] = (((size_t)rand_r(&seed) * RAND_MAX + rand_r(&seed)) % lines) * 64;
+} // pool_place
+
+
+// Evicts BYTES bytes at P from every level of the cache
+static void
+cache_flush(void *p, size_t bytes)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	for (char *c = p, *e = c + bytes; c < e; c += 64)
+		_mm_clflush(c);
+	_mm_mfence();
+#else
+	// Without a flush instruction, evict it by reading through a larger buffer
+	static char *thrash;
+	static size_t thrash_size = 64 << 20;
+	volatile char sink;
+
+	if (!thrash && !(thrash = calloc(1, thrash_size)))
+		return;
+	for (size_t i = 0; i < thrash_size; i += 64)
+		sink = thrash[i];
+	(void)sink;
+	(void)p, (void)bytes;
+#endif
+} // cache_flush
+
+
+// Runs either ROTATE, or SIZED_ROTATE with items of WIDTH bytes, over every
+// STRIDE'th one of the NLEFTS left sizes in LEFTS of an SZ item array, LOOPS
+// times.  Returns the time taken in ns.  With CACHE_COLD each rotation is
+// timed on its own, after the array has been flushed, and with CACHE_POOL the
+// rotations are spread around the pool instead of being done upon A
+static double
+time_lefts(rotate_function *rotate, sized_rotate_function *sized_rotate, void *a, size_t SZ,
+	   size_t width, size_t *lefts, size_t nlefts, size_t stride, size_t loops)
+{
+	struct	timespec start;
+	double	total = 0;
+
+	if (cache_mode == CACHE_COLD) {
+		for (size_t j = 0; j < loops; j++) {
+			for (size_t i = 0; i < nlefts; i += stride) {
+				cache_flush(a, SZ * width);
+
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				if (sized_rotate)
+					sized_rotate(a, lefts[i], SZ - lefts[i], width);
+				else
+					rotate(a, lefts[i], SZ - lefts[i]);
+				double	tim = elapsed(&start) - clock_overhead;
+
+				total += (tim > 0) ? tim : 0;
+			}
+		}
+		return total;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (cache_mode == CACHE_POOL) {
+		size_t	k = 0;
+
+		for (size_t j = 0; j < loops; j++) {
+			for (size_t i = 0; i < nlefts; i += stride, k++) {
+				void	*p = pool + pool_places[k % POOL_PLACES];
+
+				if (sized_rotate)
+					sized_rotate(p, lefts[i], SZ - lefts[i], width);
+				else
+					rotate(p, lefts[i], SZ - lefts[i]);
 			}
+		}
+	} else if (sized_rotate) {
+		for (size_t j = 0; j < loops; j++)
+			for (size_t i = 0; i < nlefts; i += stride)
+				sized_rotate(a, lefts[i], SZ - lefts[i], width);
+	} else {
+		for (size_t j = 0; j < loops; j++)
+			for (size_t i = 0; i < nlefts; i += stride)
+				rotate(a, lefts[i], SZ - lefts[i]);
+	}
+
+	return elapsed(&start);
+} // time_lefts
+
+
+// Runs rotations over LEFTS, untimed, for the warmup period.  This brings the
+// array into the cache, and the CPU clock up to speed, so that the first
+// algorithm that is timed doesn't pay for it.  The clock is only checked every
+// so often, so that it costs little for the smaller arrays
+static void
+warm_lefts(rotate_function *rotate, sized_rotate_function *sized_rotate, void *a, size_t SZ,
+	   size_t width, size_t *lefts, size_t nlefts)
+{
+	struct	timespec start;
+
+	if (opt.warmup <= 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t i = 0; ; i = (i + 1) % nlefts) {
+		if (sized_rotate)
+			sized_rotate(a, lefts[i], SZ - lefts[i], width);
+		else
+			rotate(a, lefts[i], SZ - lefts[i]);
+
+		if (((i % 16) == 0) && (elapsed(&start) >= (opt.warmup * 1e9)))
+			break;
+	}
+} // warm_lefts
+
+
+// Time that each of the baselines is run for at each size
+#define ROOF_BUDGET	0.01
+
+
+// Copies the first half over the second half
+static size_t
+roof_memcpy(char *p, size_t bytes)
+{
+	size_t	half = bytes / 2;
+
+	memcpy(p + half, p, half);
+
+	return 2 * half;
+} // roof_memcpy
+
+
+// Slides all but the first cache line down by a cache line
+static size_t
+roof_memmove(char *p, size_t bytes)
+{
+	size_t	n = (bytes > 64) ? bytes - 64 : bytes / 2;
+
+	memmove(p, p + (bytes - n), n);
+
+	return 2 * n;
+} // roof_memmove
+
+
+// The STREAM triad, being x = y + k*z over thirds of the buffer.  Integers are
+// used, since the test array holds denormals when it is viewed as doubles
+static size_t
+roof_triad(char *p, size_t bytes)
+{
+	size_t	n = bytes / (3 * sizeof(uint64_t));
+	uint64_t * restrict x = (uint64_t *)p;
+	uint64_t * restrict y = x + n;
+	uint64_t * restrict z = y + n;
+
+	for (size_t i = 0; i < n; i++)
+		x[i] = y[i] + (3 * z[i]);
+
+	return 3 * n * sizeof(uint64_t);
+} // roof_triad
+
+
+// The baselines each move data around within BYTES bytes at P, the same as a
+// rotation of BYTES bytes would, and return the bytes of traffic that they made
+typedef size_t (roof_kernel_t)(char *p, size_t bytes);
+
+static roof_kernel_t *roof_kernels[ROOF_NUM] = {roof_memcpy, roof_memmove, roof_triad};
+
+
+// Runs KERNEL LOOPS times upon BYTES bytes, in the same way that time_lefts()
+// runs the rotations for the current cache mode.  Returns the time in ns
+static double
+roof_run(roof_kernel_t *kernel, char *a, size_t bytes, size_t loops)
+{
+	struct	timespec start;
+	double	total = 0;
+
+	if (cache_mode == CACHE_COLD) {
+		for (size_t j = 0; j < loops; j++) {
+			cache_flush(a, bytes);
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			kernel(a, bytes);
+			double	tim = elapsed(&start) - clock_overhead;
+
+			total += (tim > 0) ? tim : 0;
+		}
+		return total;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (cache_mode == CACHE_POOL) {
+		for (size_t j = 0; j < loops; j++)
+			kernel(pool + pool_places[j % POOL_PLACES], bytes);
+	} else {
+		for (size_t j = 0; j < loops; j++)
+			kernel(a, bytes);
+	}
+
+	return elapsed(&start);
+} // roof_run
+
+
+// Measures the GB/s of traffic that each of the baselines gets through on
+// BYTES bytes at A, for the current cache mode, into ROOF.  Each is the median
+// over opt.trials trials.  The results are kept, as every algorithm at a size
+// shares the same ceiling
+static void
+roof_measure(char *a, size_t bytes, double *roof)
+{
+	static struct {
+		size_t	bytes;
+		int	cache;
+		double	roof[ROOF_NUM];
+	} seen[MAX_LIST];
+	static size_t nseen, next;
+	double	times[MAX_TRIALS];
+
+	for (size_t i = 0; i < nseen; i++) {
+		if ((seen[i].bytes == bytes) && (seen[i].cache == cache_mode)) {
+			memcpy(roof, seen[i].roof, sizeof(seen[i].roof));
+			return;
+		}
+	}
+
+	for (int k = 0; k < ROOF_NUM; k++) {
+		size_t	traffic = roof_kernels[k](a, bytes), loops;
+		double	tim = roof_run(roof_kernels[k], a, bytes, 1);
+
+		loops = (tim > 0) ? (size_t)((ROOF_BUDGET * 1e9) / (tim * opt.trials)) : 1;
+		if (loops < 1)
+			loops = 1;
+		if ((cache_mode == CACHE_COLD) && (loops > (COLD_SAMPLES / opt.trials)))
+			loops = (COLD_SAMPLES / opt.trials) + 1;
+
+		for (size_t t = 0; t < opt.trials; t++)
+			times[t] = roof_run(roof_kernels[k], a, bytes, loops) / loops;
+
+		stats_t	st = stats_of(times, opt.trials);
+
+		roof[k] = (st.median > 0) ? traffic / st.median : 0;
+	}
+
+	seen[next].bytes = bytes;
+	seen[next].cache = cache_mode;
+	memcpy(seen[next].roof, roof, sizeof(seen[next].roof));
+	next = (next + 1) % MAX_LIST;
+	if (nseen < MAX_LIST)
+		nseen++;
+} // roof_measure
+
+
+// The array that copy_rotation() and rotate_copy_rotation() copy from
+static uintptr_t *copy_src;
+
+
+// Exits if the SZ items of WIDTH bytes at GOT aren't the items at SRC rotated
+// by a left size of LEFT, as a wrong rotation's time means nothing
+static void
+check_result(const char *name, const void *got, const void *src, size_t SZ, size_t left, size_t width)
+{
+	const char *g = got, *s = src;
+	size_t	na = left * width, nb = (SZ - left) * width;
+
+	if (memcmp(g, s + na, nb) || memcmp(g + nb, s, na)) {
+		printf("%s gave the wrong result for a left of %zu of %zu items\n", name, left, SZ);
+		exit(1);
+	}
+} // check_result
+
+
+// Checks either ROTATE or SIZED_ROTATE upon the SZ items of WIDTH bytes at A
+// against a reference rotation made with memcpy(), with a smaller block on the
+// left, and then on the right.  The copy mode's rotations copy from copy_src
+// rather than rotating A in place, so they are checked against it, and all
+// others against a copy of A taken before each rotation
+static void
+check_rotate(rotate_function *rotate, sized_rotate_function *sized_rotate, const char *name,
+	     void *a, size_t SZ, size_t width)
+{
+	size_t	lefts[] = { 1 + ((SZ - 2) / 3), SZ - 1 - ((SZ - 2) / 7) };
+	char	*was;
+
+	if (SZ < 2)
+		return;
+
+	was = malloc(SZ * width);
+	if (!was) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	for (size_t i = 0; i < (sizeof(lefts) / sizeof(*lefts)); i++) {
+		memcpy(was, (rotate && copy_src) ? (void *)copy_src : a, SZ * width);
+		if (sized_rotate)
+			sized_rotate(a, lefts[i], SZ - lefts[i], width);
+		else
+			rotate(a, lefts[i], SZ - lefts[i]);
+		check_result(name, a, was, SZ, lefts[i], width);
+	}
+	free(was);
+} // check_rotate
+
+
+// Times either ROTATE or SIZED_ROTATE upon an SZ item array, as opt.trials
+// separate trials, and returns the spread of the time taken per rotation.  If
+// a time budget was set, one pass over the left sizes is timed first, to work
+// out how many loops fit within the budget.  The loops are then shared out
+// among the trials.  If there are fewer loops than trials, then each trial is
+// given an interleaved share of the left sizes instead, so that the whole test
+// still takes about the same time, and the trials still see the same spread of
+// left sizes.  With CACHE_COLD, every rotation is so much slower to set up
+// that the budget is ignored, and each trial is just an interleaved share of
+// no more than COLD_SAMPLES of the left sizes.  The rotation is checked by
+// check_rotate() before any of it, and a wrong one exits under NAME
+static stats_t
+test_time(rotate_function *rotate, sized_rotate_function *sized_rotate, const char *name,
+	  void *a, size_t SZ, size_t width)
+{
+	size_t	nlefts, loops, *lefts = test_lefts(SZ, &nlefts, &loops);
+	size_t	trials = opt.trials, stride = 1, total = 0;
+	double	tim, times[MAX_TRIALS], counts[PERF_NUM] = {0}, roof[ROOF_NUM];
+	stats_t	st;
+
+	check_rotate(rotate, sized_rotate, name, a, SZ, width);
+
+	if (cache_mode == CACHE_POOL)
+		pool_place(SZ * width);
+
+	if (opt.roofline)
+		roof_measure(a, SZ * width, roof);
+
+	warm_lefts(rotate, sized_rotate, a, SZ, width, lefts, nlefts);
+
+	if (cache_mode == CACHE_COLD) {
+		loops = 1;
+		if (nlefts >= trials) {
+			stride = nlefts / COLD_SAMPLES;
+			if (stride < trials)
+				stride = trials;
+		}
+	} else if (opt.budget > 0) {
+		tim = time_lefts(rotate, sized_rotate, a, SZ, width, lefts, nlefts, 1, 1);
+		loops = (tim > 0) ? (size_t)((opt.budget * 1e9) / tim) : 1;
+		if (loops < 1)
+			loops = 1;
+	}
+
+	if (cache_mode != CACHE_COLD) {
+		if (loops >= trials)
+			loops /= trials;
+		else if (nlefts >= trials)
+			stride = trials;
+	}
+
+#ifdef TSR_COUNT_MOVES
+	memset(&tsr_moves, 0, sizeof(tsr_moves));
+#endif
+
+	for (size_t t = 0; t < trials; t++) {
+		size_t	first = (stride > 1) ? t : 0;
+		size_t	count = (nlefts - first + stride - 1) / stride;
+
+		if (opt.counters)
+			perf_start();
+		tim = time_lefts(rotate, sized_rotate, a, SZ, width, lefts + first, nlefts - first, stride, loops);
+		if (opt.counters)
+			perf_stop(counts);
+
+		times[t] = tim / (loops * count);
+		total += loops * count;
+	}
+	free(lefts);
+
+	st = stats_of(times, trials);
+	for (int i = 0; i < PERF_NUM; i++)
+		if (perf_fd[i] >= 0)
+			st.perf[i] = counts[i] / total;
+	if (opt.roofline)
+		memcpy(st.roof, roof, sizeof(roof));
+
+#ifdef TSR_COUNT_MOVES
+	st.reads = (double)tsr_moves.reads / total;
+	st.writes = (double)tsr_moves.writes / total;
+	st.copied = (double)tsr_moves.copied / total;
+#endif
+
+	return st;
+} // test_time
+
+
+// Times rotate() upon an SZ item array, and reports the time taken per rotation
+static void
+test_rotate(rotate_function *rotate, char *name, uintptr_t *a, size_t SZ)
+{
+	stats_t	st = test_time(rotate, NULL, name, a, SZ, sizeof(*a));
+
+	report(name, false, SZ, sizeof(*a), &st);
+} // test_rotate
+
+
+// Thread scaling mode.  Times the multi-threaded V2 against the single threaded
+// SIMD V2 with every power of 2 number of threads up to the number of CPUs, for
+// every test size that is large enough to be split across the thread pool
+static void
+test_threads(uintptr_t *a)
+{
+	int	ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	char	label[64];
+
+	info("Thread scaling with %d CPUs, splitting rotations of %zu bytes and up\n",
+	     ncpus, tsr_mt_threshold);
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+
+		if ((SZ > nvals) || ((SZ * sizeof(*a)) < tsr_mt_threshold))
+			continue;
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		test_rotate(triple_shift_rotate_v2_simd, "Triple Shift V2 SIMD", a, SZ);
+
+		for (int nthreads = 1; ; nthreads *= 2) {
+			if (nthreads > ncpus)
+				nthreads = ncpus;
+
+			nthreads = tsr_pool_init(nthreads);
+			snprintf(label, sizeof(label), "V2 MT %d Thread%s", nthreads, (nthreads > 1) ? "s" : "");
+			test_rotate(triple_shift_rotate_v2_mt, label, a, SZ);
+
+			if (nthreads >= ncpus)
+				break;
+		}
+	}
+
+	tsr_pool_destroy();
+} // test_threads
+
+
+// Segment lengths that the batched workload is built from.  Each segment is a
+// random length from 2 up to the given size, to mimic the tail end of a merge
+size_t	batch_steps[] = {10, 50, 100, 500, 1000};
+
+// Number of times that the whole batch is rotated and timed, after a warmup
+#define BATCH_LOOPS	20
+
+
+// Checks one pass of ROTATE over every segment in JOBS, or of rotate_batch()
+// if ROTATE is NULL, against a reference rotation of each segment made with
+// memcpy().  The segments lie end to end, so they are all copied at once
+static void
+check_batch(rotate_function *rotate, bool threaded, const char *name, rotate_batch_t *jobs, size_t njobs)
+{
+	rotate_batch_t *last = jobs + njobs - 1;
+	uintptr_t *first = jobs[0].base, *was;
+	size_t	n = ((uintptr_t *)last->base + last->left + last->right) - first;
+
+	was = malloc(sizeof(*was) * n);
+	if (!was) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+	memcpy(was, first, sizeof(*was) * n);
+
+	if (rotate)
+		for (size_t i = 0; i < njobs; i++)
+			rotate(jobs[i].base, jobs[i].left, jobs[i].right);
+	else
+		rotate_batch(jobs, njobs, sizeof(uintptr_t), threaded);
+
+	for (size_t i = 0; i < njobs; i++)
+		check_result(name, jobs[i].base, was + ((uintptr_t *)jobs[i].base - first),
+			     jobs[i].left + jobs[i].right, jobs[i].left, sizeof(uintptr_t));
+	free(was);
+} // check_batch
+
+
+// Times the BATCH_LOOPS rotations of every segment in JOBS, one call at a time
+// via rotate(), and prints the time taken per segment.  The first pass over the
+// segments is a warmup, and every pass after it is timed as one trial.  They
+// are all checked by check_batch() first
+static void
+test_batch_calls(rotate_function *rotate, char *name, rotate_batch_t *jobs, size_t njobs, size_t maxlen)
+{
+	struct	timespec start;
+	double	times[BATCH_LOOPS];
+
+	check_batch(rotate, false, name, jobs, njobs);
+
+	for (size_t j = 0; j <= BATCH_LOOPS; j++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (size_t i = 0; i < njobs; i++)
+			rotate(jobs[i].base, jobs[i].left, jobs[i].right);
+
+		if (j > 0)
+			times[j - 1] = elapsed(&start) / njobs;
+	}
+
+	stats_t	st = stats_of(times, BATCH_LOOPS);
+	report(name, false, maxlen, sizeof(uintptr_t), &st);
+} // test_batch_calls
+
+
+// Times BATCH_LOOPS calls of rotate_batch() upon all of JOBS, and prints the
+// time taken per segment.  As above, the first call is a warmup, and the
+// segments are checked first
+static void
+test_batch_batched(bool threaded, char *name, rotate_batch_t *jobs, size_t njobs, size_t maxlen)
+{
+	struct	timespec start;
+	double	times[BATCH_LOOPS];
+
+	check_batch(NULL, threaded, name, jobs, njobs);
+
+	for (size_t j = 0; j <= BATCH_LOOPS; j++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		rotate_batch(jobs, njobs, sizeof(uintptr_t), threaded);
+
+		if (j > 0)
+			times[j - 1] = elapsed(&start) / njobs;
+	}
+
+	stats_t	st = stats_of(times, BATCH_LOOPS);
+	report(name, false, maxlen, sizeof(uintptr_t), &st);
+} // test_batch_batched
+
+
+// Batched workload mode.  The whole test array is cut up into segments of
+// random length, each with a random split point, and all of the segments are
+// rotated, firstly one call at a time, and then via rotate_batch()
+static void
+test_batch(uintptr_t *a)
+{
+	rotate_batch_t *jobs;
+	int	nthreads = tsr_pool_init(0);
+
+	// Every segment is at least 2 items long
+	jobs = malloc(sizeof(*jobs) * (MAX_VALS / 2));
+	if (!jobs) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	info("Batched rotation of independent segments, %d threads\n", nthreads);
+
+	for (size_t step = 0; step < (sizeof(batch_steps) / sizeof(*batch_steps)); step++) {
+		size_t	maxlen = batch_steps[step], njobs = 0;
+
+		srand(1);
+		for (size_t pos = 0; ; njobs++) {
+			size_t	len = 2 + (rand() % (maxlen - 1));
+
+			if ((pos + len) > MAX_VALS)
+				break;
+
+			jobs[njobs].base = a + pos;
+			jobs[njobs].left = 1 + (rand() % (len - 1));
+			jobs[njobs].right = len - jobs[njobs].left;
+			pos += len;
+		}
+
+		report_header("MAX LEN", "TIME/SEGMENT");
+
+		test_batch_calls(triple_shift_rotate_v2, "Triple Shift Rotate V2", jobs, njobs, maxlen);
+		test_batch_calls(triple_shift_rotate_v2_simd, "Triple Shift V2 SIMD", jobs, njobs, maxlen);
+		test_batch_batched(false, "rotate_batch()", jobs, njobs, maxlen);
+		if (nthreads > 1)
+			test_batch_batched(true, "rotate_batch() Threaded", jobs, njobs, maxlen);
+	}
+
+	tsr_pool_destroy();
+	free(jobs);
+} // test_batch
+
+
+// Scratch buffer sizes, in bytes, that triple_shift_rotate_v2_buf() is tested
+// with.  0 is the same as plain V2, and no more than TSR_SCRATCH_LIMIT is used
+size_t	scratch_sizes[] = {0, 2048, 4096, 8192, 16384};
+
+// The scratch buffer handed to scratch_rotation()
+static void	*scratch_buf;
+static size_t	scratch_size;
+
+
+static void
+scratch_rotation(uintptr_t *array, size_t left, size_t right)
+{
+	triple_shift_rotate_v2_buf(array, left, right, scratch_buf, scratch_size);
+} // scratch_rotation
+
+
+// Scratch buffer mode.  Times triple_shift_rotate_v2_buf() with every size of
+// scratch buffer, alongside the Auxiliary and Bridge rotations which malloc()
+// their scratch space on every call
+static void
+test_scratch(uintptr_t *a)
+{
+	size_t	nsizes = sizeof(scratch_sizes) / sizeof(*scratch_sizes);
+	char	label[64];
+
+	scratch_buf = malloc(scratch_sizes[nsizes - 1]);
+	if (!scratch_buf) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+
+		if (SZ > nvals)
+			continue;
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		test_rotate(auxiliary_rotation, "Aux Rotation (N/2 Aux)", a, SZ);
+		test_rotate(bridge_rotation, "Bridge Rotate (N/3 Aux)", a, SZ);
+
+		for (size_t s = 0; s < nsizes; s++) {
+			scratch_size = scratch_sizes[s];
+			snprintf(label, sizeof(label), "V2 %zuKB Scratch", scratch_size / 1024);
+			test_rotate(scratch_rotation, label, a, SZ);
+		}
+	}
+
+	free(scratch_buf);
+	scratch_buf = NULL;
+} // test_scratch
+
+
+// The usual way of getting a rotated copy, being a copy and then a rotation
+static void
+copy_rotation(uintptr_t *array, size_t left, size_t right)
+{
+	memcpy(array, copy_src, (left + right) * sizeof(*array));
+	triple_shift_rotate_v2_simd(array, left, right);
+} // copy_rotation
+
+
+static void
+rotate_copy_rotation(uintptr_t *array, size_t left, size_t right)
+{
+	rotate_copy(array, copy_src, left, right);
+} // rotate_copy_rotation
+
+
+// Rotate copy mode.  Times rotate_copy() against a memcpy() followed by an
+// in-place V2 rotation, as well as rotate_copy() with the non-temporal stores
+// always used, and never used
+static void
+test_copy(uintptr_t *a)
+{
+	size_t	threshold = tsr_nt_threshold;
+
+	copy_src = malloc(sizeof(*a) * nvals);
+	if (!copy_src) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+	for (size_t i = 0; i < nvals; i++)
+		copy_src[i] = i;
+
+	info("rotate_copy() uses non-temporal stores from %zu bytes\n", threshold);
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+
+		if (SZ > nvals)
+			continue;
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		test_rotate(copy_rotation, "memcpy() + V2 SIMD", a, SZ);
+		test_rotate(rotate_copy_rotation, "rotate_copy()", a, SZ);
+
+		tsr_nt_threshold = SIZE_MAX;
+		test_rotate(rotate_copy_rotation, "rotate_copy() Cached", a, SZ);
+		tsr_nt_threshold = 0;
+		test_rotate(rotate_copy_rotation, "rotate_copy() Streamed", a, SZ);
+		tsr_nt_threshold = threshold;
+	}
+
+	free(copy_src);
+	copy_src = NULL;
+} // test_copy
+
+
+// The prefetch distances, in bytes, that large mode times the _far kernels with
+static const size_t prefetch_distances[] = { 0, 256, 512, 1024, 2048, 4096 };
+
+
+// Large array mode.  Times V2 SIMD with the path that it takes for arrays that
+// are smaller than the LLC, against the path for arrays larger than the LLC,
+// with each of the prefetch_distances[].  Either path is forced by setting the
+// threshold between them, so the sizes given should be larger than the LLC
+static void
+test_large(uintptr_t *a)
+{
+	size_t	nsizes = sizeof(prefetch_distances) / sizeof(*prefetch_distances);
+	size_t	threshold = tsr_nt_threshold, distance = tsr_prefetch_distance;
+	char	label[64];
+
+	info("V2 SIMD takes the large array path from %zu bytes, prefetching %zu bytes ahead\n",
+	     threshold, distance);
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+
+		if (SZ > nvals)
+			continue;
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		tsr_nt_threshold = SIZE_MAX;
+		test_rotate(triple_shift_rotate_v2_simd, "V2 Cached", a, SZ);
+
+		tsr_nt_threshold = 0;
+		for (size_t d = 0; d < nsizes; d++) {
+			tsr_prefetch_distance = prefetch_distances[d];
+			snprintf(label, sizeof(label), "V2 Far %zuB Prefetch", tsr_prefetch_distance);
+			test_rotate(triple_shift_rotate_v2_simd, label, a, SZ);
+		}
+
+		tsr_nt_threshold = threshold;
+		tsr_prefetch_distance = distance;
+	}
+} // test_large
+
+
+// The byte offsets from a cache line boundary that misaligned mode places the
+// array at.  The items are left misaligned too, which V2 SIMD doesn't mind
+static const size_t misalign_offsets[] = { 0, 1, 4, 8, 16, 32, 63 };
+
+
+// Misaligned base mode.  Times V2 SIMD upon an array of uintptr_t that starts
+// at each of the misalign_offsets[] past a cache line boundary
+static void
+test_misalign(void)
+{
+	size_t	noffsets = sizeof(misalign_offsets) / sizeof(*misalign_offsets);
+	char	label[64], *buf;
+	stats_t	st;
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step], bytes = (SZ * sizeof(uintptr_t)) + 64;
+
+		// aligned_alloc() wants a multiple of the alignment
+		buf = aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+		if (!buf) {
+			printf("malloc() failure\n");
+			exit(1);
+		}
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		for (size_t o = 0; o < noffsets; o++) {
+			char	*base = buf + misalign_offsets[o];
+
+			for (size_t i = 0; i < SZ; i++)
+				memcpy(base + (i * sizeof(uintptr_t)), &i, sizeof(i));
+
+			snprintf(label, sizeof(label), "V2 SIMD +%zu Bytes", misalign_offsets[o]);
+			st = test_time(NULL, triple_shift_rotate_v2_simd_sized, label, base, SZ, sizeof(uintptr_t));
+			report(label, false, SZ, sizeof(uintptr_t), &st);
+		}
+
+		free(buf);
+	}
+} // test_misalign
+
+
+// Record size mode.  Times each of the sized_rotations[] at each of the widths,
+// which default to the record_widths[], to show where V2 and the Aux rotation
+// cross over as the records grow.  The array sizes are in records, so larger
+// records make for larger arrays
+static void
+test_records(uintptr_t *a)
+{
+	stats_t	st;
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		for (size_t w = 0; w < opt.nwidths; w++) {
+			for (sized_rotate_function_t *f = sized_rotations; f->rotate; f++) {
+				if (f->skip)
+					continue;
+
+				st = test_time(NULL, f->rotate, f->name, a, SZ, opt.widths[w]);
+				report(f->name, true, SZ, opt.widths[w], &st);
+			}
+		}
+	}
+} // test_records
+
+
+// Number of items that the V2 stack buffer holds.  A smaller block of up to
+// this many items takes the rotate_small() path, as does any overlap between
+// the blocks of up to this many items with rotate_overlap()
+static size_t
+stream_items(void)
+{
+#ifdef TSR_TUNABLE
+	return tsr_tune.min_stream_size / sizeof(uintptr_t);
+#else
+	return TSR_MIN_STREAM_SIZE / sizeof(uintptr_t);
+#endif
+} // stream_items
+
+
+// Corner case mode.  Rather than averaging over every left size, each of the
+// rotations[] is timed with the one left size of each scenario, being:
+//
+//   - A single item on the left, or the right
+//   - Equal halves
+//   - Blocks that differ in size by 1, 8 or 64 items
+//   - A smaller block, or a difference between the blocks, that is just
+//     within, or just past, what the stack buffer holds
+//
+// The blocks are given exact sizes, so the number of items that is rotated
+// may be one less than the array size, as shown in the ITEMS column
+static void
+test_corners(uintptr_t *a)
+{
+	size_t	ms = stream_items();
+	char	label[128];
+
+	info("Corner cases, with a stack buffer of %zu items\n", ms);
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+		struct {
+			const char *what;
+			size_t	left;
+			size_t	right;
+		} cases[] = {
+			{"left = 1",               1,                  SZ - 1},
+			{"right = 1",              SZ - 1,             1},
+			{"equal halves",           SZ / 2,             SZ / 2},
+			{"right - left = 1",       (SZ - 1) / 2,       ((SZ - 1) / 2) + 1},
+			{"right - left = 8",       (SZ - 8) / 2,       ((SZ - 8) / 2) + 8},
+			{"right - left = 64",      (SZ - 64) / 2,      ((SZ - 64) / 2) + 64},
+			{"right - left = buffer",  (SZ - ms) / 2,      ((SZ - ms) / 2) + ms},
+			{"right - left = buffer+1", (SZ - ms - 1) / 2, ((SZ - ms - 1) / 2) + ms + 1},
+			{"left = buffer",          ms,                 SZ - ms},
+			{"left = buffer+1",        ms + 1,             SZ - ms - 1},
+		};
+
+		if (SZ > nvals)
+			continue;
+
+		for (size_t c = 0; c < (sizeof(cases) / sizeof(*cases)); c++) {
+			size_t	left = cases[c].left, right = cases[c].right;
+
+			// Skip any scenario that this array size is too small for,
+			// including those where SZ - ms and the like have wrapped
+			if ((left < 1) || (right < 1) || (left >= SZ) || (right >= SZ) ||
+			    ((left + right) > SZ) || ((left + right) < (SZ - 1)))
+				continue;
+
+			snprintf(label, sizeof(label), "%s (%zu + %zu)", cases[c].what, left, right);
+			report_case = cases[c].what;
+			opt.left = left;
+
+			if (opt.format == FORMAT_TABLE)
+				printf("\n%s", label);
+			report_header("ITEMS", "TIME/ROTATE");
+
+			for (int fno = 0; ; fno++) {
+				rotate_function_t *f = get_function(fno);
+				if (f == NULL)
+					break;
+
+				if (!f->skip)
+					test_rotate(f->rotate, f->name, a, left + right);
+			}
+		}
+	}
+
+	report_case = "";
+} // test_corners
+
+
+// Seconds that each cell of the heatmap is timed for, unless given via -t
+#define HEATMAP_BUDGET	0.01
+
+
+// Heatmap mode.  Each of the rotations[] is timed at every left/N ratio from
+// 1/steps up to (steps-1)/steps, for each array size, rather than averaged over
+// all of them.  This shows up the shape of how each algorithm's cost varies
+// with the split, such as with the number of passes that V2's ring loops take,
+// and which algorithm is fastest where.  The table is a grid for each size of
+// the ns per rotation, with a column for each algorithm, and the fastest one
+// marked.  CSV and JSON get one result per cell, with the ratio as its case
+static void
+test_heatmap(uintptr_t *a)
+{
+	size_t	nrot = sizeof(rotations) / sizeof(*rotations), nsel = 0, nratios = opt.steps - 1;
+	rotate_function_t **sel = malloc(sizeof(*sel) * nrot);
+	double	*grid = malloc(sizeof(*grid) * nrot * nratios), warmup = opt.warmup;
+	char	ratio[32];
+
+	if (!sel || !grid) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	for (int fno = 0; ; fno++) {
+		rotate_function_t *f = get_function(fno);
+		if (f == NULL)
+			break;
+
+		if (!f->skip)
+			sel[nsel++] = f;
+	}
+
+	if (opt.budget <= 0)
+		opt.budget = HEATMAP_BUDGET;
+
+	info("Rotation heatmap, in ns per rotation, of:\n");
+	for (size_t f = 0; f < nsel; f++)
+		info("  [%2zu] %s\n", f + 1, sel[f]->name);
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step];
+
+		if (SZ > nvals)
+			continue;
+
+		// The ratios are swept in order for each algorithm, so that only
+		// the first of them needs to be warmed up for
+		for (size_t f = 0; f < nsel; f++) {
+			for (size_t r = 0; r < nratios; r++) {
+				size_t	left = (SZ * (r + 1)) / opt.steps;
+
+				if (left < 1)
+					left = 1;
+				if (left > (SZ - 1))
+					left = SZ - 1;
+
+				opt.left = left;
+				opt.warmup = (r == 0) ? warmup : 0;
+
+				stats_t	st = test_time(sel[f]->rotate, NULL, sel[f]->name, a, SZ, sizeof(*a));
+				grid[(f * nratios) + r] = st.median;
+
+				snprintf(ratio, sizeof(ratio), "%.4f", (double)(r + 1) / opt.steps);
+				report_case = ratio;
+				if (opt.format != FORMAT_TABLE)
+					report(sel[f]->name, false, SZ, sizeof(*a), &st);
+			}
+		}
+		opt.warmup = warmup;
+
+		if (opt.format != FORMAT_TABLE)
+			continue;
+
+		printf("\n%zu items\n", SZ);
+		printf("LEFT/N ");
+		for (size_t f = 0; f < nsel; f++)
+			printf("      [%2zu]", f + 1);
+		printf("   FASTEST\n");
+
+		for (size_t r = 0; r < nratios; r++) {
+			size_t	best = 0;
+
+			printf("%6.4f ", (double)(r + 1) / opt.steps);
+			for (size_t f = 0; f < nsel; f++) {
+				if (grid[(f * nratios) + r] < grid[(best * nratios) + r])
+					best = f;
+				printf(" %9.1f", grid[(f * nratios) + r]);
+			}
+			printf("      [%2zu]\n", best + 1);
+		}
+		fflush(stdout);
+	}
+
+	report_case = "";
+	free(grid);
+	free(sel);
+} // test_heatmap
+
+
+// Size of the reads and writes that the rewrite of a file is done with
+#define FILE_CHUNK	(1024 * 1024)
+
+// Size of the buffer that triple_shift_rotate_stream() is given
+#define FILE_STREAM_BUF	(16 * 1024 * 1024)
+
+// The range that file_check() rotates, being records of 3 bytes at an offset
+// that is neither page nor record aligned, and the stream buffer size that it
+// uses, which is small enough that the range takes many chunks
+#define FILE_CHECK_OFFSET	4099
+#define FILE_CHECK_LEFT		3343
+#define FILE_CHECK_RIGHT	23339
+#define FILE_CHECK_BUF		4096
+
+
+// Writes out the file FD, and drops all of it from the page cache
+static void
+file_drop(int fd)
+{
+	fsync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+} // file_drop
+
+
+// The usual way to rotate a file.  The RIGHT bytes after the first LEFT bytes
+// of the file FD, followed by those LEFT bytes, are copied into the file OUT
+// through BUF, and OUT is synced.  Returns 0, or -1 if any of it failed
+static int
+file_rewrite(int fd, int out, size_t left, size_t right, char *buf)
+{
+	size_t	from[2] = {left, 0}, len[2] = {right, left};
+	off_t	to = 0;
+
+	for (int i = 0; i < 2; i++) {
+		for (size_t done = 0; done < len[i]; ) {
+			size_t	n = ((len[i] - done) < FILE_CHUNK) ? len[i] - done : FILE_CHUNK;
+			ssize_t	got = pread(fd, buf, n, from[i] + done);
+
+			if ((got <= 0) || (pwrite(out, buf, got, to) != got))
+				return -1;
+			done += got, to += got;
+		}
+	}
+	return fsync(out);
+} // file_rewrite
+
+
+// Checks triple_shift_rotate_stream() through SBUF if it is not NULL, or else
+// triple_shift_rotate_file(), upon the FILE_CHECK_* range of the file FD,
+// against a reference rotation made with memcpy() of the bytes read back
+static void
+file_check(const char *name, const char *path, int fd, char *sbuf)
+{
+	size_t	na = FILE_CHECK_LEFT * 3, nb = FILE_CHECK_RIGHT * 3;
+	char	*was = malloc(na + nb), *now = malloc(na + nb);
+	int	ret;
+
+	if (!was || !now) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	if (pread(fd, was, na + nb, FILE_CHECK_OFFSET) != (ssize_t)(na + nb)) {
+		perror(path);
+		exit(1);
+	}
+
+	if (sbuf)
+		ret = triple_shift_rotate_stream(fd, FILE_CHECK_OFFSET, FILE_CHECK_LEFT, FILE_CHECK_RIGHT,
+		                                 3, sbuf, FILE_CHECK_BUF, NULL);
+	else
+		ret = triple_shift_rotate_file(fd, FILE_CHECK_OFFSET, FILE_CHECK_LEFT, FILE_CHECK_RIGHT,
+		                               3, TSR_FILE_SYNC);
+
+	if ((ret != 0) || (pread(fd, now, na + nb, FILE_CHECK_OFFSET) != (ssize_t)(na + nb))) {
+		perror(path);
+		exit(1);
+	}
+
+	check_result(name, now, was, FILE_CHECK_LEFT + FILE_CHECK_RIGHT, FILE_CHECK_LEFT, 3);
+	free(now);
+	free(was);
+} // file_check
+
+
+// File mode.  Rotates the first quarter of an opt.file_mb MB file at PATH to
+// the end of it, or by the -d fraction of it, with triple_shift_rotate_file()
+// upon a mapping of the file, with triple_shift_rotate_stream() through a
+// FILE_STREAM_BUF buffer, and by rewriting it into a second file.  All of them
+// wait for the data to reach the disk.  The file is dropped from the page cache
+// before every trial, so every trial is as if the file were far larger than
+// the page cache.  The mmap and stream rotations are checked by file_check()
+// before they are timed
+static void
+test_file(const char *path)
+{
+	size_t	bytes = opt.file_mb << 20, left, right;
+	double	times[MAX_TRIALS];
+	tsr_stream_stats_t io = {0, 0};
+	char	*buf, *sbuf, out[PATH_MAX];
+	struct	timespec start;
+	int	fd, fo;
+	stats_t	st;
+
+	left = bytes * ((opt.dist == DIST_RATIO) ? opt.ratio : 0.25);
+	right = bytes - left;
+	snprintf(out, sizeof(out), "%s.new", path);
+
+	buf = malloc(FILE_CHUNK);
+	sbuf = malloc(FILE_STREAM_BUF);
+	if (!buf || !sbuf) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	fo = open(out, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if ((fd < 0) || (fo < 0)) {
+		perror((fd < 0) ? path : out);
+		exit(1);
+	}
+
+	for (size_t i = 0; i < FILE_CHUNK; i++)
+		buf[i] = i * 7;
+	for (size_t done = 0; done < bytes; done += FILE_CHUNK) {
+		size_t	n = ((bytes - done) < FILE_CHUNK) ? bytes - done : FILE_CHUNK;
+
+		if (pwrite(fd, buf, n, done) != (ssize_t)n) {
+			perror(path);
+			exit(1);
+		}
+	}
+
+	info("Rotating %zu of the %zu bytes of %s, from a cold page cache every time\n",
+	     left, bytes, path);
+	report_header("BYTES", "TIME/ROTATE");
+
+	file_check("V2 mmap", path, fd, NULL);
+	for (size_t t = 0; t < opt.trials; t++) {
+		file_drop(fd);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (triple_shift_rotate_file(fd, 0, left, right, 1, TSR_FILE_SYNC) != 0) {
+			perror(path);
+			exit(1);
+		}
+		times[t] = elapsed(&start);
+	}
+	st = stats_of(times, opt.trials);
+	report("V2 mmap", false, bytes, 1, &st);
+
+	file_check("V2 stream", path, fd, sbuf);
+	for (size_t t = 0; t < opt.trials; t++) {
+		file_drop(fd);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if ((triple_shift_rotate_stream(fd, 0, left, right, 1, sbuf, FILE_STREAM_BUF, &io) != 0) ||
+		    (fsync(fd) != 0)) {
+			perror(path);
+			exit(1);
+		}
+		times[t] = elapsed(&start);
+	}
+	st = stats_of(times, opt.trials);
+	report("V2 stream", false, bytes, 1, &st);
+	info("    per op: read %.2fx and written %.2fx the file, through a %d MB buffer\n",
+	     (double)io.read / (opt.trials * bytes), (double)io.written / (opt.trials * bytes),
+	     FILE_STREAM_BUF >> 20);
+
+	for (size_t t = 0; t < opt.trials; t++) {
+		file_drop(fd);
+		file_drop(fo);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (file_rewrite(fd, fo, left, right, buf) != 0) {
+			perror(out);
+			exit(1);
+		}
+		times[t] = elapsed(&start);
+	}
+	st = stats_of(times, opt.trials);
+	report("Read/Rewrite", false, bytes, 1, &st);
+
+	close(fd);
+	close(fo);
+	unlink(path);
+	unlink(out);
+	free(sbuf);
+	free(buf);
+} // test_file
+
+
+#ifdef TSR_TUNABLE
+//------------------------------------------------------------------------------
+//                              Calibration Mode
+//------------------------------------------------------------------------------
+
+// The MIN_STREAM_SIZE values, in bytes, that calibration picks from.  Those
+// over TSR_MAX_STREAM_SIZE are skipped
+size_t	calib_streams[] = {0, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384};
+
+// The array sizes that each MIN_STREAM_SIZE value is timed with
+size_t	calib_sizes[] = {1000, 10000, 100000};
+
+// Roughly how many items get moved by each timing, and how many times each
+// timing is repeated, with only the fastest being kept to filter out noise.
+// Timings are also capped at CALIB_CALLS rotations, for the tiny arrays
+#define CALIB_WORK	100000000ULL
+#define CALIB_CALLS	1000000ULL
+#define CALIB_REPEATS	5
+
+// Number of left sizes that each array size is timed with
+#define CALIB_SPLITS	64
+
+// A larger MIN_STREAM_SIZE only costs more stack space, and it is almost never
+// slower, so the smallest value that scores within this many percent of the
+// best one is chosen
+#define CALIB_SLACK	2
+
+
+// Times rotate() over an SZ item array, with each of the NSPLITS left sizes
+// in SPLITS, moving about WORK items in total, and returns the fastest time
+// per rotation out of CALIB_REPEATS
+static double
+calib_time(rotate_function *rotate, uintptr_t *a, size_t SZ, size_t *splits, size_t nsplits, size_t work)
+{
+	struct	timespec start, end;
+	size_t	loops = work / (SZ * nsplits);
+	double	best = 0;
+
+	if (loops > (CALIB_CALLS / nsplits))
+		loops = CALIB_CALLS / nsplits;
+	if (loops < 1)
+		loops = 1;
+
+	for (int r = 0; r < CALIB_REPEATS; r++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (size_t j = 0; j < loops; j++)
+			for (size_t i = 0; i < nsplits; i++)
+				rotate(a, splits[i], SZ - splits[i]);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		double tim = ((end.tv_sec - start.tv_sec) * 1000000000) + (end.tv_nsec - start.tv_nsec);
+		tim /= (loops * nsplits);
+		if ((r == 0) || (tim < best))
+			best = tim;
+	}
+
+	return best;
+} // calib_time
+
+
+// Finds the MIN_STREAM_SIZE that gives the fastest V2 rotations.  It only makes
+// a difference where the smaller block, or the difference between the blocks,
+// fits in the stack buffer, so only those left sizes are timed.  Every value is
+// scored by how much slower it is than the best value at each array size, so
+// that the larger arrays don't drown out the smaller ones
+static size_t
+calib_min_stream(uintptr_t *a)
+{
+	size_t	ncands = sizeof(calib_streams) / sizeof(*calib_streams);
+	size_t	nsizes = sizeof(calib_sizes) / sizeof(*calib_sizes);
+	size_t	span = TSR_MAX_STREAM_SIZE / sizeof(*a), splits[CALIB_SPLITS * 3];
+	size_t	best = tsr_tune.min_stream_size, crossover = tsr_tune.reverse_crossover;
+	double	times[ncands][nsizes], scores[ncands], best_score = 0;
+
+	while ((ncands > 0) && (calib_streams[ncands - 1] > TSR_MAX_STREAM_SIZE))
+		ncands--;
+
+	printf("\n");
+	printf("   MIN_STREAM_SIZE           ITEMS         TIME/ROTATE\n");
+	printf("=======================================================\n");
+
+	for (size_t s = 0; s < nsizes; s++) {
+		size_t	SZ = calib_sizes[s], nsplits = 0;
+
+		// A small left block, a small right block, and a small overlap
+		for (size_t k = 0; k < CALIB_SPLITS; k++) {
+			size_t	d = 1 + ((k * span) / CALIB_SPLITS);
+
+			if (d >= SZ)
+				break;
+
+			splits[nsplits++] = d;
+			splits[nsplits++] = SZ - d;
+			splits[nsplits++] = (SZ - d) / 2;
+		}
+
+		for (size_t c = 0; c < ncands; c++) {
+			tsr_tune_set(calib_streams[c], crossover);
+			times[c][s] = calib_time(triple_shift_rotate_v2, a, SZ, splits, nsplits, CALIB_WORK);
+			printf("%10zu bytes              %7zu        %10.3fns\n", calib_streams[c], SZ, times[c][s]);
+		}
+	}
+
+	for (size_t c = 0; c < ncands; c++) {
+		scores[c] = 0;
+		for (size_t s = 0; s < nsizes; s++) {
+			double	fastest = times[0][s];
+
+			for (size_t o = 1; o < ncands; o++)
+				if (times[o][s] < fastest)
+					fastest = times[o][s];
+
+			scores[c] += times[c][s] / fastest;
+		}
+
+		if ((c == 0) || (scores[c] < best_score))
+			best_score = scores[c];
+	}
+
+	for (size_t c = 0; c < ncands; c++) {
+		if (scores[c] <= (best_score * (100 + CALIB_SLACK)) / 100) {
+			best = calib_streams[c];
+			break;
+		}
+	}
+
+	tsr_tune_set(best, crossover);
+	return best;
+} // calib_min_stream
+
+
+// Finds the array size at which triple_reverse_rotate() should switch to the
+// middle-outwards reversal.  Both reversals are timed at doubling array sizes,
+// and the crossover is the smallest size from which outwards is always faster.
+// Returns SIZE_MAX if outwards never wins
+static size_t
+calib_reverse_crossover(uintptr_t *a)
+{
+	size_t	stream = tsr_tune.min_stream_size, crossover = SIZE_MAX;
+	size_t	splits[16], nsplits = sizeof(splits) / sizeof(*splits);
+
+	printf("\n");
+	printf("      ITEMS              INWARDS            OUTWARDS\n");
+	printf("=======================================================\n");
+
+	for (size_t SZ = 1000; SZ <= MAX_VALS; SZ *= 2) {
+		for (size_t i = 0; i < nsplits; i++)
+			splits[i] = (SZ * (i + 1)) / (nsplits + 1);
+
+		tsr_tune_set(stream, SIZE_MAX);
+		double	inwards = calib_time(triple_reverse_rotate, a, SZ, splits, nsplits, CALIB_WORK);
+
+		tsr_tune_set(stream, 0);
+		double	outwards = calib_time(triple_reverse_rotate, a, SZ, splits, nsplits, CALIB_WORK);
+
+		printf("    %7zu         %10.3fns        %10.3fns\n", SZ, inwards, outwards);
+
+		if (outwards >= inwards)
+			crossover = SIZE_MAX;
+		else if (crossover == SIZE_MAX)
+			crossover = SZ;
+	}
+
+	tsr_tune_set(stream, crossover);
+	return crossover;
+} // calib_reverse_crossover
+
+
+// The algorithms that the hybrid rotate() picks between, in the order of the
+// TSR_V2, TSR_TRINITY, TSR_BRIDGE and TSR_AUX enums
+rotate_function_t hybrid_algos[TSR_NUM_ALGOS] = {
+	{triple_shift_rotate_v2,  "TSR_V2"},
+	{trinity_rotation,        "TSR_TRINITY"},
+	{bridge_rotation,         "TSR_BRIDGE"},
+	{auxiliary_rotation,      "TSR_AUX"},
+};
+
+// The range of each table column of the hybrid rotate(), in 64ths of the total
+size_t	hybrid_cols[TSR_HYBRID_COLS + 1] = {0, 2, 8, 16, 24, 33};
+
+// Fewer items are moved for each hybrid table timing, as there are many cells
+#define CALIB_TABLE_WORK	(CALIB_WORK / 10)
+
+
+// Measures every cell of the hybrid rotate() decision table, and writes it out
+// to FP as a TSR_HYBRID_TABLE definition.  Each row is timed at the midpoint of
+// its power of 2 range, and each column with the smaller block being four
+// fractions from within its range, on both the left and the right side
+static void
+calib_hybrid(uintptr_t *a, FILE *fp)
+{
+	size_t	splits[8], nsplits;
+	tsr_hybrid_t table[TSR_HYBRID_ROWS][TSR_HYBRID_COLS];
+
+	printf("\n");
+	printf("   ITEMS  RATIO      V2 TRINITY  BRIDGE     AUX   PICKS\n");
+	printf("=======================================================\n");
+
+	for (size_t row = 0; row < TSR_HYBRID_ROWS; row++) {
+		size_t	SZ = (row == 0) ? 1 : (3ULL << row) / 2;
+
+		if (SZ > MAX_VALS)
+			SZ = MAX_VALS;
+
+		for (size_t col = 0; col < TSR_HYBRID_COLS; col++) {
+			double	times[TSR_NUM_ALGOS];
+
+			table[row][col].best = table[row][col].inplace = TSR_V2;
+			if (SZ < 2)
+				continue;
+
+			nsplits = 0;
+			for (size_t k = 0; k < 4; k++) {
+				size_t	lo = hybrid_cols[col], hi = hybrid_cols[col + 1];
+				size_t	m = (SZ * (lo * 8 + ((hi - lo) * (2 * k + 1)))) / (64 * 8);
+
+				if (m < 1)
+					m = 1;
+				if (m > (SZ / 2))
+					m = SZ / 2;
+
+				splits[nsplits++] = m;
+				splits[nsplits++] = SZ - m;
+			}
+
+			for (int algo = 0; algo < TSR_NUM_ALGOS; algo++)
+				times[algo] = calib_time(hybrid_algos[algo].rotate, a, SZ, splits, nsplits, CALIB_TABLE_WORK);
+
+			// Stick with V2 unless another is faster by more than the
+			// noise, so that the table doesn't flip between near equals
+			double	v2 = (times[TSR_V2] * 100) / (100 + CALIB_SLACK);
+
+			for (int algo = TSR_V2 + 1; algo < TSR_NUM_ALGOS; algo++) {
+				int	best = table[row][col].best;
+
+				if (times[algo] < ((best == TSR_V2) ? v2 : times[best]))
+					table[row][col].best = algo;
+				if ((algo == TSR_TRINITY) && (times[algo] < v2))
+					table[row][col].inplace = algo;
+			}
+
+			printf("%8zu %2zu-%2zu/64 %7.0f %7.0f %7.0f %7.0f   %c %c\n", SZ,
+			       hybrid_cols[col], hybrid_cols[col + 1] - 1, times[TSR_V2], times[TSR_TRINITY],
+			       times[TSR_BRIDGE], times[TSR_AUX], "VTBA"[table[row][col].best],
+			       "VTBA"[table[row][col].inplace]);
+		}
+	}
+
+	fprintf(fp, "#ifndef TSR_HYBRID_TABLE\n");
+	fprintf(fp, "#define TSR_HYBRID_TABLE { \\\n");
+	for (size_t row = 0; row < TSR_HYBRID_ROWS; row++) {
+		fprintf(fp, "\t/* 2^%-2zu */ {", row);
+		for (size_t col = 0; col < TSR_HYBRID_COLS; col++)
+			fprintf(fp, "%s{%s, %s}", col ? ", " : "", hybrid_algos[table[row][col].best].name,
+				hybrid_algos[table[row][col].inplace].name);
+		fprintf(fp, "}, \\\n");
+	}
+	fprintf(fp, "}\n");
+	fprintf(fp, "#endif\n");
+} // calib_hybrid
+
+
+// Calibration mode.  Measures the best MIN_STREAM_SIZE and triple_reverse_rotate()
+// crossover for this machine, along with the hybrid rotate() decision table,
+// and writes them out as a header to PATH, which can then be built against via
+// -DTSR_CONFIG
+static void
+test_calibrate(uintptr_t *a, const char *path)
+{
+	size_t	stream, crossover;
+	FILE	*fp;
+
+	printf("Calibrating tunables for the %s kernels\n", tsr_simd->name);
+
+	stream = calib_min_stream(a);
+	crossover = calib_reverse_crossover(a);
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		perror(path);
+		exit(1);
+	}
+
+	fprintf(fp, "// Generated by `rotate-tune calibrate` for the machine it was run upon.\n");
+	fprintf(fp, "// Build with -DTSR_CONFIG='\"%s\"' to use these values\n\n", path);
+	fprintf(fp, "#ifndef TSR_MIN_STREAM_SIZE\n");
+	fprintf(fp, "#define TSR_MIN_STREAM_SIZE\t%zu\n", stream);
+	fprintf(fp, "#endif\n\n");
+	fprintf(fp, "#ifndef TSR_REVERSE_CROSSOVER\n");
+	if (crossover == SIZE_MAX)
+		fprintf(fp, "#define TSR_REVERSE_CROSSOVER\tSIZE_MAX\n");
+	else
+		fprintf(fp, "#define TSR_REVERSE_CROSSOVER\t%zu\n", crossover);
+	fprintf(fp, "#endif\n\n");
+
+	// The hybrid table is measured with the tunables found above
+	calib_hybrid(a, fp);
+	fclose(fp);
+
+	printf("\nMIN_STREAM_SIZE = %zu bytes, TSR_REVERSE_CROSSOVER = ", stream);
+	if (crossover == SIZE_MAX)
+		printf("never");
+	else
+		printf("%zu items", crossover);
+	printf(", written to %s\n", path);
+} // test_calibrate
+#endif // TSR_TUNABLE
+
+
+// One of the tests run by test_all()
+typedef struct {
+	rotate_function		*rotate;
+	sized_rotate_function	*sized_rotate;
+	char			*name;
+	size_t			width;
+	stats_t			st;
+} bench_t;
+
+
+// The default mode.  Times every selected rotations[] entry, and then every
+// selected sized_rotations[] entry at each item width, upon each array size.
+// If asked, the tests at each size are run in a random order, so that no one
+// algorithm always runs first, or always right after some other.  The results
+// are then held back, and reported in the usual order
+static void
+test_all(uintptr_t *a)
+{
+	size_t	nrot = sizeof(rotations) / sizeof(*rotations);
+	size_t	nsized = sizeof(sized_rotations) / sizeof(*sized_rotations);
+	size_t	max = nrot + (nsized * opt.nwidths), *order;
+	unsigned int seed = time(NULL) ^ getpid();
+	bool	native = false;
+	bench_t	*b;
+
+	b = malloc(sizeof(*b) * max);
+	order = malloc(sizeof(*order) * max);
+	if (!b || !order) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+
+	// The uintptr_t rotations[] are only run if their width was asked for
+	for (size_t w = 0; w < opt.nwidths; w++)
+		if (opt.widths[w] == sizeof(*a))
+			native = true;
+
+	for (size_t step = 0; step < opt.nsizes; step++) {
+		size_t	SZ = opt.sizes[step], nb = 0;
+
+		for (int fno = 0; native; fno++) {
+			rotate_function_t *f = get_function(fno);
+			if (f == NULL)
+				break;
+
+			if (!f->skip)
+				b[nb++] = (bench_t){ .rotate = f->rotate, .name = f->name, .width = sizeof(*a) };
+		}
+
+		// Now the item size generic rotations across each width
+		for (size_t w = 0; w < opt.nwidths; w++)
+			for (sized_rotate_function_t *f = sized_rotations; f->rotate; f++)
+				if (!f->skip)
+					b[nb++] = (bench_t){ .sized_rotate = f->rotate, .name = f->name, .width = opt.widths[w] };
+
+		for (size_t i = 0; i < nb; i++)
+			order[i] = i;
+
+		if (opt.shuffle) {
+			for (size_t i = nb; i > 1; i--) {
+				size_t	j = rand_r(&seed) % i, t = order[i - 1];
+
+				order[i - 1] = order[j], order[j] = t;
+			}
+		}
+
+		report_header("ITEMS", "TIME/ROTATE");
+
+		for (size_t i = 0; i < nb; i++) {
+			bench_t	*t = b + order[i];
+
+			t->st = test_time(t->rotate, t->sized_rotate, t->name, a, SZ, t->width);
+			if (!opt.shuffle)
+				report(t->name, t->sized_rotate != NULL, SZ, t->width, &t->st);
+		}
+
+		if (opt.shuffle)
+			for (size_t i = 0; i < nb; i++)
+				report(b[i].name, b[i].sized_rotate != NULL, SZ, b[i].width, &b[i].st);
+	}
+
+	free(order);
+	free(b);
+} // test_all
+
+
+#ifdef TSR_TUNABLE
+#define TEST_MODES	"threads|batch|scratch|copy|large|misalign|records|corners|heatmap|file [path]|calibrate [file]"
+#else
+#define TEST_MODES	"threads|batch|scratch|copy|large|misalign|records|corners|heatmap|file [path]"
+#endif
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options] [" TEST_MODES "]\n", prog);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -a NAMES    Only run the algorithms whose names contain any of the\n");
+	fprintf(stderr, "              comma separated NAMES, ignoring case\n");
+	fprintf(stderr, "  -l          List the algorithms and exit\n");
+	fprintf(stderr, "  -s SIZES    Comma separated array sizes, in items\n");
+	fprintf(stderr, "  -w WIDTHS   Comma separated item widths, in bytes\n");
+	fprintf(stderr, "  -t SECS     Time budget for each algorithm at each size\n");
+	fprintf(stderr, "  -d DIST     Left block sizes: all (every size), random, or a\n");
+	fprintf(stderr, "              fraction of the array size such as 0.25\n");
+	fprintf(stderr, "  -o FORMAT   Output as table, csv or json\n");
+	fprintf(stderr, "  -r TRIALS   Number of timed trials that each test is split into\n");
+	fprintf(stderr, "  -W SECS     Untimed warmup before each test\n");
+	fprintf(stderr, "  -R          Run the algorithms in a random order at each size\n");
+	fprintf(stderr, "  -c CPUS     Pin to the comma separated CPUs.  Threads share them\n");
+	fprintf(stderr, "  -p          Also read the hardware performance counters\n");
+	fprintf(stderr, "  -g STEPS    Number of left/N steps in the heatmap\n");
+	fprintf(stderr, "  -C CACHES   Comma separated cache modes to test each in turn: warm\n");
+	fprintf(stderr, "              (the default), cold (flushed before every rotation),\n");
+	fprintf(stderr, "              or pool (random places in a pool far larger than LLC)\n");
+	fprintf(stderr, "  -P MB       Size of the pool used by -C pool\n");
+	fprintf(stderr, "  -F MB       Size of the file that the file mode rotates\n");
+	fprintf(stderr, "  -b          Also measure memcpy, memmove and STREAM triad baselines\n");
+	fprintf(stderr, "              at each size, and give the rotations' traffic as a\n");
+	fprintf(stderr, "              percentage of the fastest of them\n");
+	exit(1);
+} // usage
+
+
+// Parses ARG as a comma separated list of up to MAX_LIST numbers of at least
+// MIN into LIST.  Returns the count, or 0 if ARG isn't valid
+static size_t
+parse_list(const char *arg, size_t *list, size_t min)
+{
+	size_t	count = 0;
+	char	*end;
+
+	for (;;) {
+		unsigned long long val = strtoull(arg, &end, 10);
+
+		if ((end == arg) || (val < min) || (count == MAX_LIST))
+			return 0;
+		list[count++] = val;
+
+		if (*end == '\0')
+			return count;
+		if (*end != ',')
+			return 0;
+		arg = end + 1;
+	}
+} // parse_list
+
+
+// Parses ARG as a comma separated list of cache mode names into opt.caches.
+// Returns false if ARG isn't valid
+static bool
+parse_caches(const char *arg)
+{
+	for (opt.ncaches = 0; *arg; ) {
+		size_t	len = strcspn(arg, ",");
+		int	c;
+
+		for (c = 0; c < CACHE_NUM; c++)
+			if ((strlen(cache_names[c]) == len) && (strncmp(cache_names[c], arg, len) == 0))
+				break;
+
+		if ((c == CACHE_NUM) || (opt.ncaches == CACHE_NUM))
+			return false;
+		opt.caches[opt.ncaches++] = c;
+
+		arg += len;
+		if (*arg == ',')
+			arg++;
+	}
+	return opt.ncaches > 0;
+} // parse_caches
+
+
+// Returns true if NAME contains PAT, ignoring case
+static bool
+name_matches(const char *name, const char *pat, size_t len)
+{
+	for ( ; *name; name++)
+		if (strncasecmp(name, pat, len) == 0)
+			return true;
+	return false;
+} // name_matches
+
+
+// Skips every algorithm whose name doesn't contain one of the comma separated
+// names in LIST.  Returns false if any of the names matched nothing at all
+static bool
+select_algorithms(const char *list)
+{
+	for (rotate_function_t *f = rotations; f->rotate; f++)
+		f->skip = true;
+	for (sized_rotate_function_t *f = sized_rotations; f->rotate; f++)
+		f->skip = true;
+
+	while (*list) {
+		size_t	len = strcspn(list, ",");
+		bool	found = false;
+
+		for (rotate_function_t *f = rotations; f->rotate; f++)
+			if (name_matches(f->name, list, len))
+				f->skip = false, found = true;
+		for (sized_rotate_function_t *f = sized_rotations; f->rotate; f++)
+			if (name_matches(f->name, list, len))
+				f->skip = false, found = true;
+
+		if (!found || (len == 0)) {
+			fprintf(stderr, "No algorithm matches: %.*s\n", (int)len, list);
+			return false;
+		}
+
+		list += len;
+		if (*list == ',')
+			list++;
+	}
+	return true;
+} // select_algorithms
+
+
+static void
+list_algorithms(void)
+{
+	for (rotate_function_t *f = rotations; f->rotate; f++)
+		printf("%s\n", f->name);
+	for (sized_rotate_function_t *f = sized_rotations; f->rotate; f++)
+		printf("%s (any width)\n", f->name);
+	exit(0);
+} // list_algorithms
+
+
+// Pins this thread, and any threads that it later starts, to the comma
+// separated list of CPUs in opt.cpus
+static void
+pin_cpus(void)
+{
+	size_t	cpus[MAX_LIST], ncpus = parse_list(opt.cpus, cpus, 0);
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < ncpus; i++) {
+		if (cpus[i] >= CPU_SETSIZE) {
+			fprintf(stderr, "Invalid CPU: %zu\n", cpus[i]);
+			exit(1);
+		}
+		CPU_SET(cpus[i], &set);
+	}
+
+	if ((ncpus == 0) || (sched_setaffinity(0, sizeof(set), &set) != 0)) {
+		fprintf(stderr, "Unable to pin to CPUs: %s\n", opt.cpus);
+		exit(1);
+	}
+} // pin_cpus
+
+
+// Parses the command line options into opt, and returns the index of the first
+// argument that isn't an option
+static int
+parse_options(int argc, char *argv[])
+{
+	char	*end;
+	int	c;
+
+	opt.nsizes = sizeof(test_steps) / sizeof(*test_steps);
+	memcpy(opt.sizes, test_steps, sizeof(test_steps));
+	while ((c = getopt(argc, argv, "a:ls:w:t:d:o:r:W:Rc:pg:C:P:bF:h")) != -1) {
+		switch (c) {
+		case 'a':
+			if (!select_algorithms(optarg))
+				exit(1);
+			break;
+		case 'l':
+			list_algorithms();
+			break;
+		case 's':
+			if (!(opt.nsizes = parse_list(optarg, opt.sizes, 2)))
+				usage(argv[0]);
+			break;
+		case 'w':
+			if (!(opt.nwidths = parse_list(optarg, opt.widths, 1)))
+				usage(argv[0]);
+			break;
+		case 't':
+			opt.budget = strtod(optarg, &end);
+			if ((*end != '\0') || (opt.budget <= 0))
+				usage(argv[0]);
+			break;
+		case 'd':
+			if (strcmp(optarg, "all") == 0) {
+				opt.dist = DIST_ALL;
+			} else if (strcmp(optarg, "random") == 0) {
+				opt.dist = DIST_RANDOM;
+			} else {
+				opt.dist = DIST_RATIO;
+				opt.ratio = strtod(optarg, &end);
+				if ((*end != '\0') || (opt.ratio <= 0) || (opt.ratio >= 1))
+					usage(argv[0]);
+			}
+			break;
+		case 'o':
+			if (strcmp(optarg, "table") == 0)
+				opt.format = FORMAT_TABLE;
+			else if (strcmp(optarg, "csv") == 0)
+				opt.format = FORMAT_CSV;
+			else if (strcmp(optarg, "json") == 0)
+				opt.format = FORMAT_JSON;
+			else
+				usage(argv[0]);
+			break;
+		case 'r':
+			opt.trials = strtoul(optarg, &end, 10);
+			if ((*end != '\0') || (opt.trials < 1) || (opt.trials > MAX_TRIALS))
+				usage(argv[0]);
+			break;
+		case 'W':
+			opt.warmup = strtod(optarg, &end);
+			if ((*end != '\0') || (opt.warmup < 0))
+				usage(argv[0]);
+			break;
+		case 'R':
+			opt.shuffle = true;
+			break;
+		case 'p':
+			opt.counters = true;
+			break;
+		case 'b':
+			opt.roofline = true;
+			break;
+		case 'F':
+			opt.file_mb = strtoul(optarg, &end, 10);
+			if ((*end != '\0') || (opt.file_mb < 1))
+				usage(argv[0]);
+			break;
+		case 'g':
+			opt.steps = strtoul(optarg, &end, 10);
+			if ((*end != '\0') || (opt.steps < 2) || (opt.steps > 1000))
+				usage(argv[0]);
+			break;
+		case 'C':
+			if (!parse_caches(optarg))
+				usage(argv[0]);
+			break;
+		case 'P':
+			opt.pool_mb = strtoul(optarg, &end, 10);
+			if ((*end != '\0') || (opt.pool_mb < 1))
+				usage(argv[0]);
+			break;
+		case 'c':
+			opt.cpus = optarg;
+			pin_cpus();
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	return optind;
+} // parse_options
+
+
+// Usage: rotate [options] [threads|batch|scratch|copy|large|misalign|records|corners|heatmap|file [path]]
+//        rotate-tune [options] [threads|batch|scratch|copy|large|misalign|records|corners|heatmap|file [path]|calibrate [file]]
+//
+// With no mode argument, all the selected rotations[] and sized_rotations[] are
+// compared.  The optional mode argument selects one of the other test modes
+// instead.  The calibrate mode is only in the rotate-tune build, which has
+// TSR_TUNABLE defined.  Run with -h for the options
+int
+main(int argc, char *argv[])
+{
+	uintptr_t *a;
+	int	arg = parse_options(argc, argv);
+
+	if (arg < argc)
+		opt.mode = argv[arg];
+
+	// The widths depend upon the mode, if they weren't given via -w
+	if ((opt.nwidths == 0) && (strcmp(opt.mode, "records") == 0)) {
+		opt.nwidths = sizeof(record_widths) / sizeof(*record_widths);
+		memcpy(opt.widths, record_widths, sizeof(record_widths));
+	} else if (opt.nwidths == 0) {
+		opt.nwidths = sizeof(test_widths) / sizeof(*test_widths);
+		memcpy(opt.widths, test_widths, sizeof(test_widths));
+	}
+
+	// Make sure that the test array is large enough for every test
+	for (size_t s = 0; s < opt.nsizes; s++) {
+		for (size_t w = 0; w < opt.nwidths; w++) {
+			size_t	need = ((opt.sizes[s] * opt.widths[w]) + sizeof(*a) - 1) / sizeof(*a);
+
+			if (need > nvals)
+				nvals = need;
+		}
+		if (opt.sizes[s] > nvals)
+			nvals = opt.sizes[s];
+	}
+
+	a = malloc(sizeof(*a) * nvals);
+	if (!a) {
+		printf("malloc() failure\n");
+		exit(1);
+	}
+	for (size_t i = 0; i < nvals; i++)
+		a[i] = i;
+
+#ifdef TSR_TUNABLE
+	if (strcmp(opt.mode, "calibrate") == 0) {
+		printf("SIMD kernels in use: %s\n", tsr_simd->name);
+		test_calibrate(a, ((arg + 1) < argc) ? argv[arg + 1] : "tsr-config.h");
+		free(a);
+		return 0;
+	}
+#endif
+
+	if ((strcmp(opt.mode, "rotate") != 0) && (strcmp(opt.mode, "threads") != 0) &&
+	    (strcmp(opt.mode, "batch") != 0) && (strcmp(opt.mode, "scratch") != 0) &&
+	    (strcmp(opt.mode, "copy") != 0) && (strcmp(opt.mode, "large") != 0) &&
+	    (strcmp(opt.mode, "corners") != 0) && (strcmp(opt.mode, "heatmap") != 0) &&
+	    (strcmp(opt.mode, "file") != 0) && (strcmp(opt.mode, "misalign") != 0) &&
+	    (strcmp(opt.mode, "records") != 0)) {
+		fprintf(stderr, "Unknown test mode: %s\n", opt.mode);
+		usage(argv[0]);
+	}
+
+	// The corners and heatmap modes pick their own left sizes
+	if ((strcmp(opt.mode, "corners") == 0) || (strcmp(opt.mode, "heatmap") == 0))
+		opt.dist = DIST_FIXED;
+
+	if (opt.counters && (perf_open() == 0))
+		fprintf(stderr, "No hardware counters are available, so only times will be given\n");
+
+	cache_init(sizeof(*a) * nvals);
+
+	report_begin();
 
-			clock_gettime(CLOCK_MONOTONIC, &end);
+	// Each cache mode is a separate run of the whole test mode
+	for (size_t c = 0; c < opt.ncaches; c++) {
+		cache_mode = opt.caches[c];
+		if (opt.ncaches > 1)
+			info("\nCache mode: %s\n", cache_names[cache_mode]);
 
-			double tim = ((end.tv_sec - start.tv_sec) * 1000000000) + (end.tv_nsec - start.tv_nsec);
-			printf("%-24s    %7lu        %10.3fns\n", f->name, SZ, tim/runs);
+		if (strcmp(opt.mode, "threads") == 0) {
+			test_threads(a);
+		} else if (strcmp(opt.mode, "batch") == 0) {
+			test_batch(a);
+		} else if (strcmp(opt.mode, "scratch") == 0) {
+			test_scratch(a);
+		} else if (strcmp(opt.mode, "copy") == 0) {
+			test_copy(a);
+		} else if (strcmp(opt.mode, "large") == 0) {
+			test_large(a);
+		} else if (strcmp(opt.mode, "misalign") == 0) {
+			test_misalign();
+		} else if (strcmp(opt.mode, "records") == 0) {
+			test_records(a);
+		} else if (strcmp(opt.mode, "corners") == 0) {
+			test_corners(a);
+		} else if (strcmp(opt.mode, "heatmap") == 0) {
+			test_heatmap(a);
+		} else if (strcmp(opt.mode, "file") == 0) {
+			test_file(((arg + 1) < argc) ? argv[arg + 1] : "rotate-file.tmp");
+		} else {
+			test_all(a);
 		}
 	}
 
+	report_end();
+	perf_close();
+	cache_free();
 	free(a);
+	return 0;
 } // main
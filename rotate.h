@@ -30,6 +30,8 @@
 #ifndef ROTATE_H
 #define ROTATE_H
 
+#include "triple-shift-rotate-moves.h"
+
 void outsidein_reversal(uintptr_t *array, size_t block_size)
 {
 	uintptr_t *pta, *ptb, swap;
@@ -39,6 +41,8 @@ void outsidein_reversal(uintptr_t *array, size_t block_size)
 
 	block_size /= 2;
 
+	TSR_MOVES(2 * block_size * sizeof(uintptr_t), 2 * block_size * sizeof(uintptr_t));
+
 	while (block_size--)
 	{
 		swap = *pta; *pta++ = *--ptb; *ptb = swap;
@@ -56,6 +60,8 @@ void insideout_reversal(uintptr_t *array, size_t block_size)
 	pta = array + block_size;
 	ptb -= block_size;
 
+	TSR_MOVES(2 * block_size * sizeof(uintptr_t), 2 * block_size * sizeof(uintptr_t));
+
 	while (block_size--)
 	{
 		swap = *--pta; *pta = *ptb; *ptb++ = swap;
@@ -69,6 +75,8 @@ void forward_block_swap(uintptr_t *array, const size_t start1, const size_t star
 	pta = array + start1;
 	ptb = array + start2;
 
+	TSR_MOVES(2 * block_size * sizeof(uintptr_t), 2 * block_size * sizeof(uintptr_t));
+
 	while (block_size--)
 	{
 		swap = *pta; *pta++ = *ptb; *ptb++ = swap;
@@ -82,6 +90,8 @@ void backward_block_swap(uintptr_t *array, const size_t start1, const size_t sta
 	pta = array + start1 + block_size;
 	ptb = array + start2 + block_size;
 
+	TSR_MOVES(2 * block_size * sizeof(uintptr_t), 2 * block_size * sizeof(uintptr_t));
+
 	while (block_size--)
 	{
 		swap = *--pta; *pta = *--ptb; *ptb = swap;
@@ -175,6 +185,8 @@ void bridge_rotation(uintptr_t *array, size_t left, size_t right)
 
 			memcpy(swap, ptb, bridge * sizeof(uintptr_t));
 
+			TSR_MOVES(2 * left * sizeof(uintptr_t), 2 * left * sizeof(uintptr_t));
+
 			while (left--)
 			{
 				*--ptc = *--ptd; *ptd = *--ptb;
@@ -199,6 +211,8 @@ void bridge_rotation(uintptr_t *array, size_t left, size_t right)
 			
 			memcpy(swap, ptc, bridge * sizeof(uintptr_t));
 			
+			TSR_MOVES(2 * right * sizeof(uintptr_t), 2 * right * sizeof(uintptr_t));
+
 			while (right--)
 			{
 				*ptc++ = *pta; *pta++ = *ptb++;
@@ -217,6 +231,8 @@ void bridge_rotation(uintptr_t *array, size_t left, size_t right)
 	{
 		swap = malloc(1 * sizeof(uintptr_t));
 
+		TSR_MOVES(2 * left * sizeof(uintptr_t), 2 * left * sizeof(uintptr_t));
+
 		while (left--)
 		{
 			*swap = *pta; *pta++ = *ptb; *ptb++ = *swap;
@@ -234,6 +250,8 @@ contrev(uintptr_t * restrict pa, uintptr_t * restrict pb, uintptr_t * restrict p
 {
 	uintptr_t	* restrict stop = pa + num, t;
 
+	TSR_MOVES(4 * num * sizeof(uintptr_t), 4 * num * sizeof(uintptr_t));
+
 	while (pa != stop)
 		t = *--pb, *pb = *pa, *pa++ = *pc, *pc++ = *--pd, *pd = t;
 }
@@ -243,6 +261,8 @@ shiftrev_up(uintptr_t * restrict pa, uintptr_t * restrict pc, uintptr_t * restri
 {
 	uintptr_t	* restrict stop = pa + num, t;
 
+	TSR_MOVES(3 * num * sizeof(uintptr_t), 3 * num * sizeof(uintptr_t));
+
 	while (pa != stop)
 		t = *pc, *pc++ = *--pd, *pd = *pa, *pa++ = t;
 }
@@ -252,6 +272,8 @@ shiftrev_down(uintptr_t * restrict pa, uintptr_t * restrict pb, uintptr_t * rest
 {
 	uintptr_t	* restrict stop = pa + num, t;
 
+	TSR_MOVES(3 * num * sizeof(uintptr_t), 3 * num * sizeof(uintptr_t));
+
 	while (pa != stop)
 		t = *--pb, *pb = *pa, *pa++ = *--pd, *pd = t;
 }
@@ -261,6 +283,8 @@ justrev(uintptr_t * restrict pa, uintptr_t * restrict pb, size_t num)
 {
 	uintptr_t	* restrict stop = pa + num, t;
 
+	TSR_MOVES(2 * num * sizeof(uintptr_t), 2 * num * sizeof(uintptr_t));
+
 	while (pa != stop)
 		t = *pa, *pa++ = *--pb, *pb = t;
 }
@@ -270,6 +294,8 @@ justswap(uintptr_t * restrict pa, uintptr_t * restrict pb, size_t num)
 {
 	uintptr_t	* restrict stop = pa + num, t;
 
+	TSR_MOVES(2 * num * sizeof(uintptr_t), 2 * num * sizeof(uintptr_t));
+
 	while (pa != stop)
 		t = *pa, *pa++ = *pb, *pb++ = t;
 }
@@ -279,6 +305,8 @@ do_bridge_down(uintptr_t *pb, uintptr_t *pc, uintptr_t * restrict pd, size_t num
 {
 	uintptr_t	* restrict stop = pb - num;
 
+	TSR_MOVES(2 * num * sizeof(uintptr_t), 2 * num * sizeof(uintptr_t));
+
 	while (pb != stop)
 		*--pc = *--pd, *pd = *--pb;
 } // do_bridge_down
@@ -288,6 +316,8 @@ do_bridge_up(uintptr_t * restrict pa, uintptr_t *pb, uintptr_t *pc, size_t num)
 {
 	uintptr_t	* restrict stop = pb + num;
 
+	TSR_MOVES(2 * num * sizeof(uintptr_t), 2 * num * sizeof(uintptr_t));
+
 	while (pb != stop)
 		*pc++ = *pa, *pa++ = *pb++;
 } // do_bridge_up
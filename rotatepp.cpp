@@ -0,0 +1,251 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// C++ companion to the rotate.c test harness.  Compares tsr::rotate() from
+// triple-shift-rotate.hpp against the standard library's std::rotate(), using
+// the same test sizes and timing methodology as rotate.c.  Both trivially
+// copyable items (uintptr_t) and non-trivial items (std::string) are tested.
+// Lastly, tsr::rotate<N, K>() is compared against tsr::rotate() at the fixed
+// sizes in static_steps.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "triple-shift-rotate.hpp"
+
+// Feel free to exit this to set whatever sizes you want to test
+static const size_t	test_steps[] = {10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000};
+
+// The compile-time sizes that tsr::rotate<N, K>() is tested at, being a 16 lane
+// SIMD window and a 64 entry histogram.  Each needs its own test_static() call
+static constexpr size_t	static_steps[] = {16, 64};
+
+// std::string rotations are much slower, so cap their test sizes
+#define MAX_STRING_VALS	100000
+
+#define MAX_TIME	50000000000ULL
+
+// See test_loops() in rotate.c
+static size_t
+test_loops(size_t SZ)
+{
+	size_t	stop = MAX_TIME / (SZ * SZ);
+	size_t	div = 400 / SZ;
+
+	if (div < 1)
+		div = 1;
+
+	stop /= div;
+	if (stop < 1)
+		stop = 1;
+
+	return stop;
+} // test_loops
+
+
+// See test_gap() in rotate.c
+static size_t
+test_gap(size_t SZ)
+{
+	size_t gap = 1;
+
+	if (SZ > (100 * 1000))
+		gap = (SZ - 1) / (100 * 1000);
+
+	return gap;
+} // test_gap
+
+
+// Checks that ROTATE, with a left size of LEFT upon a copy of the first SZ
+// items of V, gives the same items as std::rotate(), and returns the same
+// position.  A wrong rotation's time means nothing, so any difference exits
+template <class T, class Rotate>
+static void
+check_rotate(const char *name, const std::vector<T> &v, size_t SZ, size_t left, Rotate rotate)
+{
+	std::vector<T> want(v.begin(), v.begin() + SZ), got(want);
+	auto	w = std::rotate(want.begin(), want.begin() + left, want.end());
+	T	*g = rotate(got.data(), got.data() + left, got.data() + SZ);
+
+	if ((got != want) || ((g - got.data()) != (w - want.begin()))) {
+		printf("%s is wrong with a left of %zu of %zu items\n", name, left, SZ);
+		exit(1);
+	}
+} // check_rotate
+
+
+// Times ROTATE across all the left sizes of the first SZ items of V and
+// prints the time taken per rotation.  ROTATE is first checked against
+// std::rotate() at both ends, and a third of the way along.  It is handed
+// pointers rather than the vector's iterators, as those only count as
+// contiguous from C++20 on.  Under the Makefile's -std=c++17, tsr::rotate()
+// would otherwise never take its stack buffer path for the uintptr_t items
+template <class T, class Rotate>
+static void
+test_rotate(const char *name, std::vector<T> &v, size_t SZ, Rotate rotate)
+{
+	struct	timespec start, end;
+	size_t	stop = test_loops(SZ), gap = test_gap(SZ), runs = 0;
+	T	*first = v.data(), *last = first + SZ;
+
+	check_rotate(name, v, SZ, 1, rotate);
+	check_rotate(name, v, SZ, SZ / 3, rotate);
+	check_rotate(name, v, SZ, SZ - 1, rotate);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t j = 0; j < stop; j++) {
+		for (size_t i = 1; i < SZ; i += gap) {
+			rotate(first, first + i, last);
+			runs++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double tim = ((end.tv_sec - start.tv_sec) * 1000000000) + (end.tv_nsec - start.tv_nsec);
+	printf("%-24s    %7lu        %10.3fns\n", name, SZ, tim/runs);
+} // test_rotate
+
+
+// Checks tsr::rotate<N, K>() against std::rotate() upon a copy of the first N
+// items of V, in the same way as check_rotate()
+template <size_t N, size_t K>
+static void
+check_static(const std::vector<uintptr_t> &v)
+{
+	std::vector<uintptr_t> want(v.begin(), v.begin() + N), got(want);
+	auto	w = std::rotate(want.begin(), want.begin() + K, want.end());
+	auto	g = tsr::rotate<N, K>(got.data());
+
+	if ((got != want) || ((g - got.data()) != (w - want.begin()))) {
+		printf("tsr::rotate<%zu, %zu> is wrong\n", N, K);
+		exit(1);
+	}
+} // check_static
+
+
+// Times tsr::rotate<N, K + 1>() for each of the K, being every left size from 1
+// to N - 1, against the runtime tsr::rotate() over the same left sizes.  Those
+// are read from LEFTS, so that the compiler can't specialise the runtime calls.
+// Every tsr::rotate<N, K + 1>() is checked against std::rotate() first
+template <size_t N, size_t... K>
+static void
+test_static(std::vector<uintptr_t> &v, std::index_sequence<K...>)
+{
+	struct	timespec start, end;
+	size_t	stop = test_loops(N), runs = 0;
+	uintptr_t *p = v.data();
+	std::vector<size_t> lefts = {(K + 1)...};
+	double	tim;
+	char	name[32];
+
+	(check_static<N, K + 1>(v), ...);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t j = 0; j < stop; j++) {
+		for (size_t left : lefts)
+			tsr::rotate(p, p + left, p + N);
+		runs += lefts.size();
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	tim = ((end.tv_sec - start.tv_sec) * 1000000000) + (end.tv_nsec - start.tv_nsec);
+	printf("%-24s    %7lu        %10.3fns\n", "tsr::rotate<uintptr_t>", N, tim/runs);
+
+	runs = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t j = 0; j < stop; j++) {
+		(tsr::rotate<N, K + 1>(p), ...);
+		runs += sizeof...(K);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	tim = ((end.tv_sec - start.tv_sec) * 1000000000) + (end.tv_nsec - start.tv_nsec);
+	snprintf(name, sizeof(name), "tsr::rotate<%zu, K>", N);
+	printf("%-24s    %7lu        %10.3fns\n", name, N, tim/runs);
+} // test_static
+
+
+int
+main()
+{
+	size_t	max_vals = 0;
+
+	for (size_t SZ : test_steps)
+		max_vals = std::max(max_vals, SZ);
+
+	std::vector<uintptr_t>	a(max_vals);
+	std::vector<std::string> s(std::min(max_vals, (size_t)MAX_STRING_VALS));
+
+	for (size_t i = 0; i < a.size(); i++)
+		a[i] = i;
+
+	// Long enough to defeat the small string optimisation
+	for (size_t i = 0; i < s.size(); i++)
+		s[i] = "Triple Shift Rotate String " + std::to_string(i);
+
+	auto std_rotate = [](auto first, auto middle, auto last) {
+		return std::rotate(first, middle, last);
+	};
+	auto tsr_rotate = [](auto first, auto middle, auto last) {
+		return tsr::rotate(first, middle, last);
+	};
+
+	for (size_t SZ : test_steps) {
+		printf("\n");
+		printf("         NAME                 ITEMS         TIME/ROTATE\n");
+		printf("=======================================================\n");
+
+		test_rotate("std::rotate<uintptr_t>", a, SZ, std_rotate);
+		test_rotate("tsr::rotate<uintptr_t>", a, SZ, tsr_rotate);
+
+		if (SZ > s.size())
+			continue;
+
+		test_rotate("std::rotate<string>", s, SZ, std_rotate);
+		test_rotate("tsr::rotate<string>", s, SZ, tsr_rotate);
+	}
+
+	printf("\nCompile-time sizes, over every left size\n");
+	printf("         NAME                 ITEMS         TIME/ROTATE\n");
+	printf("=======================================================\n");
+
+	static_assert(sizeof(static_steps) / sizeof(*static_steps) == 2,
+	              "Add a test_static() call for each of static_steps");
+
+	test_static<static_steps[0]>(a, std::make_index_sequence<static_steps[0] - 1>());
+	test_static<static_steps[1]>(a, std::make_index_sequence<static_steps[1] - 1>());
+} // main
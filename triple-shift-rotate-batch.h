@@ -0,0 +1,234 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                     Triple Shift Rotate V2 - Batched
+//
+// This file is NOT meant to be included directly.  It is included by
+// triple-shift-rotate.h, and provides rotate_batch().
+//
+// Algorithms such as in-place merge sorts will rotate many millions of small
+// independent segments.  For segments under about 100 items the cost of each
+// rotation is dominated by the call itself, and by the branches that choose
+// which path to take, rather than by moving the items.  rotate_batch() takes
+// an array of segments to rotate, and works through them a window at a time:
+//
+// 1.  The segments in the window are grouped by the path they will take.
+//     Tiny segments are rotated through a small local buffer with inlined
+//     copies, and never call out to memcpy() at all.  Those whose smaller
+//     block fits the stack buffer are split by which of the blocks is the
+//     smaller, and everything else goes to the V2 driver.  So each group
+//     then runs with the same branches taken every time.
+// 2.  While each segment is rotated, the start of the next segment in the
+//     group is prefetched, so its first cache lines arrive while we work.
+//
+// The segments MUST NOT overlap each other, as they may be rotated in any
+// order, and if requested, across the thread pool.
+
+// Number of segments that are grouped together at a time
+#define TSR_BATCH_WINDOW	256
+
+// Number of bytes of each block of the next segment that get prefetched
+#define TSR_BATCH_PREFETCH	256
+
+// Segments of up to this many bytes in total take the tiny path
+#define TSR_BATCH_TINY		256
+
+// A single segment to be rotated.  LEFT items at BASE get rotated with the
+// RIGHT items that follow them
+typedef struct {
+	void	*base;
+	size_t	left;
+	size_t	right;
+} rotate_batch_t;
+
+
+// Prefetches the start of both blocks of the segment, for writing
+static inline void
+tsr_batch_prefetch(const rotate_batch_t *job, size_t size)
+{
+	char	*pa = job->base, *pb = pa + (job->left * size);
+
+	for (size_t i = 0; i < TSR_BATCH_PREFETCH; i += 64) {
+		__builtin_prefetch(pa + i, 1, 3);
+		__builtin_prefetch(pb + i, 1, 3);
+	}
+} // tsr_batch_prefetch
+
+
+// Copies N bytes, where N is at most TSR_BATCH_TINY.  Every memcpy() here is
+// of a fixed size, so the compiler emits plain loads and stores for them.  The
+// final copy of each size class overlaps the prior ones, to cover any N
+static inline void
+tsr_batch_copy(char * restrict dst, const char * restrict src, size_t n)
+{
+	if (n >= 16) {
+		for (size_t i = 16; i < n; i += 16)
+			memcpy(dst + i - 16, src + i - 16, 16);
+		memcpy(dst + n - 16, src + n - 16, 16);
+	} else if (n >= 8) {
+		memcpy(dst, src, 8);
+		memcpy(dst + n - 8, src + n - 8, 8);
+	} else if (n >= 4) {
+		memcpy(dst, src, 4);
+		memcpy(dst + n - 4, src + n - 4, 4);
+	} else {
+		while (n--)
+			*dst++ = *src++;
+	}
+} // tsr_batch_copy
+
+
+// Rotates NJOBS segments of SIZE byte items on the calling thread
+static void
+tsr_batch_range(const rotate_batch_t *jobs, size_t njobs, size_t size)
+{
+	uint16_t tiny[TSR_BATCH_WINDOW], left[TSR_BATCH_WINDOW];
+	uint16_t right[TSR_BATCH_WINDOW], large[TSR_BATCH_WINDOW];
+
+	for ( ; njobs > 0; ) {
+		size_t	num = (njobs < TSR_BATCH_WINDOW) ? njobs : TSR_BATCH_WINDOW;
+		size_t	nt = 0, nl = 0, nr = 0, ng = 0;
+
+		// Group the window's segments by the path they'll take
+		for (size_t i = 0; i < num; i++) {
+			size_t	na = jobs[i].left * size, nb = jobs[i].right * size;
+
+			if ((na == 0) || (nb == 0))
+				continue;
+
+			if ((na + nb) <= TSR_BATCH_TINY)
+				tiny[nt++] = i;
+			else if ((na < nb) && (na <= MIN_STREAM_SIZE))
+				left[nl++] = i;
+			else if ((nb <= na) && (nb <= MIN_STREAM_SIZE))
+				right[nr++] = i;
+			else
+				large[ng++] = i;
+		}
+
+		// Tiny segments.  Copy B then A out, and the lot back in one go
+		for (size_t i = 0; i < nt; i++) {
+			const rotate_batch_t *job = jobs + tiny[i];
+			size_t	na = job->left * size, nb = job->right * size;
+			char	*pa = job->base, buf[TSR_BATCH_TINY];
+
+			TSR_MOVES(2 * (na + nb), 2 * (na + nb));
+
+			tsr_batch_copy(buf, pa + na, nb);
+			tsr_batch_copy(buf + nb, pa, na);
+			tsr_batch_copy(pa, buf, na + nb);
+		}
+
+		// Small left block.  See rotate_small()
+		for (size_t i = 0; i < nl; i++) {
+			const rotate_batch_t *job = jobs + left[i];
+			size_t	na = job->left * size, nb = job->right * size;
+			char	*pa = job->base, buf[STREAM_BUF_SIZE];
+
+			if ((i + 1) < nl)
+				tsr_batch_prefetch(jobs + left[i + 1], size);
+
+			memcpy(buf, pa, na);
+			memmove(pa, pa + na, nb);
+			memcpy(pa + nb, buf, na);
+		}
+
+		// Small right block.  See rotate_small()
+		for (size_t i = 0; i < nr; i++) {
+			const rotate_batch_t *job = jobs + right[i];
+			size_t	na = job->left * size, nb = job->right * size;
+			char	*pa = job->base, buf[STREAM_BUF_SIZE];
+
+			if ((i + 1) < nr)
+				tsr_batch_prefetch(jobs + right[i + 1], size);
+
+			memcpy(buf, pa + na, nb);
+			memmove(pa + nb, pa, na);
+			memcpy(pa, buf, nb);
+		}
+
+		// Everything else
+		for (size_t i = 0; i < ng; i++) {
+			const rotate_batch_t *job = jobs + large[i];
+
+			if ((i + 1) < ng)
+				tsr_batch_prefetch(jobs + large[i + 1], size);
+
+			triple_shift_rotate_v2_bytes(job->base, job->left * size, job->right * size);
+		}
+
+		jobs += num;
+		njobs -= num;
+	}
+} // tsr_batch_range
+
+
+typedef struct {
+	const rotate_batch_t *jobs;
+	size_t	njobs;
+	size_t	size;
+} tsr_batch_args_t;
+
+
+// Runs the part's share of the segments
+static void
+tsr_batch_part(void *arg, int part, int nparts)
+{
+	tsr_batch_args_t *b = arg;
+	size_t	s = (b->njobs * part) / nparts, e = (b->njobs * (part + 1)) / nparts;
+
+	tsr_batch_range(b->jobs + s, e - s, b->size);
+} // tsr_batch_part
+
+
+// Rotates each of the NJOBS segments in JOBS, where all items are SIZE bytes.
+// If THREADED is set, and the thread pool is started and not otherwise busy,
+// and the batch holds at least tsr_mt_threshold bytes in total, then the
+// segments are split across the thread pool
+static void
+rotate_batch(const rotate_batch_t *jobs, size_t njobs, size_t size, bool threaded)
+{
+	if (threaded && (tsr_pool.nthreads > 0)) {
+		size_t	total = 0;
+
+		for (size_t i = 0; i < njobs; i++)
+			total += jobs[i].left + jobs[i].right;
+
+		if (((total * size) >= tsr_mt_threshold) && (pthread_mutex_trylock(&tsr_pool.busy) == 0)) {
+			tsr_batch_args_t b = { .jobs = jobs, .njobs = njobs, .size = size };
+
+			tsr_pool_run(tsr_batch_part, &b, tsr_pool.nthreads + 1);
+			pthread_mutex_unlock(&tsr_pool.busy);
+			return;
+		}
+	}
+
+	tsr_batch_range(jobs, njobs, size);
+} // rotate_batch
+
+
+#undef TSR_BATCH_TINY
+#undef TSR_BATCH_PREFETCH
+#undef TSR_BATCH_WINDOW
@@ -0,0 +1,161 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                Triple Shift Rotate V2 - Caller Supplied Scratch Buffer
+//
+// This file is NOT meant to be included directly.  It is included by
+// triple-shift-rotate.h, and provides triple_shift_rotate_v2_buf().
+//
+// The Auxiliary and Bridge rotations in rotate.h are fast, but they malloc()
+// and free() their scratch space on every call, which becomes very expensive
+// once many threads are contending for the allocator.  Here, the caller hands
+// in a scratch buffer of their own instead, such as a slice of an arena, or a
+// per-thread buffer that is reused for every rotation.  No memory is ever
+// allocated, and the buffer is never written past its given size.
+//
+// The driver is V2 with the buffer taking the place of the small stack buffer
+// used by rotate_small() and rotate_overlap().  So whenever the smaller block,
+// or the overlap between the blocks, fits in the buffer, the rotation is done
+// with a single buffered move.  Otherwise the ring passes collapse the problem
+// in-place until it does fit, so the larger the buffer, the sooner that the
+// buffered moves can finish the job.  A NULL buffer, or one no larger than the
+// stack buffer, is simply plain V2.
+//
+// That only holds while the buffered moves stay within the L1 cache though.
+// Past that, the memmove() of the larger block streams through memory more
+// slowly than the ring passes do, so no more than TSR_SCRATCH_LIMIT bytes of
+// the buffer are ever used.  Memory use then has a hard bound regardless.
+
+// Most bytes of the caller's buffer that will be used
+#ifndef TSR_SCRATCH_LIMIT
+#define TSR_SCRATCH_LIMIT	16384
+#endif
+
+
+// See rotate_small() in triple-shift-rotate.h.  NA and NB are in BYTES here
+static void
+tsr_buf_small(char *pa, size_t na, size_t nb, char *buf)
+{
+	if (na < nb) {
+		memcpy(buf, pa, na);
+		memmove(pa, pa + na, nb);
+		memcpy(pa + nb, buf, na);
+	} else {
+		memcpy(buf, pa + na, nb);
+		memmove(pa + nb, pa, na);
+		memcpy(pa, buf, nb);
+	}
+} // tsr_buf_small
+
+
+// See rotate_overlap() in triple-shift-rotate.h.  NA and NB are in BYTES here
+static void
+tsr_buf_overlap(char *pa, size_t na, size_t nb, char *buf)
+{
+	char	*pb = pa + na, *pe = pb + nb;
+
+	if (na < nb) {
+		size_t	nc = nb - na;
+		char	*pc = pa + na, *pd = pc + na;
+
+		memcpy(buf, pd, nc);
+		tsr_simd->bridge_down(pc, pd, pe, na);
+		memcpy(pc, buf, nc);
+	} else {
+		size_t	nc = na - nb;
+		char	*pc = pa + nb, *pd = pc + nb;
+
+		memcpy(buf, pc, nc);
+		tsr_simd->bridge_up(pa, pb, pc, nb);
+		memcpy(pd, buf, nc);
+	}
+} // tsr_buf_overlap
+
+
+// The V2 driver, with BUFSIZE bytes of BUF in place of the stack buffer.  All
+// counts are in BYTES, as with triple_shift_rotate_v2_bytes()
+static void
+triple_shift_rotate_v2_buf_bytes(char *pa, size_t na, size_t nb, void *buf, size_t bufsize)
+{
+	if (bufsize > TSR_SCRATCH_LIMIT)
+		bufsize = TSR_SCRATCH_LIMIT;
+
+	if ((buf == NULL) || (bufsize <= MIN_STREAM_SIZE))
+		return triple_shift_rotate_v2_bytes(pa, na, nb);
+
+	for (char *pb = pa + na, *pe = pb + nb; na; nb = pe - pb, na = pb - pa) {
+		if (na < nb) {
+			size_t	no = nb - na;
+
+			if (na <= bufsize)
+				return tsr_buf_small(pa, na, nb, buf);
+
+			if (no <= bufsize)
+				return tsr_buf_overlap(pa, na, nb, buf);
+
+			for ( ; na > no; pa += no, na -= no)
+				tsr_simd->ring_positive(pa, pb, pe - na, no);
+
+			tsr_simd->ring_positive(pa, pb, pe - na, na);
+
+			pa = pb,  pe = pb + no,  pb += na;
+		} else if (na == nb) {
+			return tsr_simd->two_way_swap_block(pa, pb, na);
+		} else if (nb == 0) {
+			return;
+		} else {
+			size_t	no = na - nb;
+
+			if (nb <= bufsize)
+				return tsr_buf_small(pa, na, nb, buf);
+
+			if (no <= bufsize)
+				return tsr_buf_overlap(pa, na, nb, buf);
+
+			for ( ; nb > no; pe -= no, nb -= no)
+				tsr_simd->ring_negative(pa + nb, pb, pe, no);
+
+			tsr_simd->ring_negative(pa + nb, pb, pe, nb);
+
+			pe = pb,  pa = pb - no,  pb -= nb;
+		}
+	}
+} // triple_shift_rotate_v2_buf_bytes
+
+
+// Rotates NA items of SIZE bytes each at BASE with the NB items that follow,
+// using up to BUFSIZE bytes of the caller's scratch buffer BUF
+static void
+triple_shift_rotate_v2_buf_sized(void *base, size_t na, size_t nb, size_t size, void *buf, size_t bufsize)
+{
+	triple_shift_rotate_v2_buf_bytes(base, na * size, nb * size, buf, bufsize);
+} // triple_shift_rotate_v2_buf_sized
+
+
+static void
+triple_shift_rotate_v2_buf(uintptr_t *pa, size_t na, size_t nb, void *buf, size_t bufsize)
+{
+	triple_shift_rotate_v2_buf_bytes((char *)pa, na * sizeof(*pa), nb * sizeof(*pa), buf, bufsize);
+} // triple_shift_rotate_v2_buf
@@ -0,0 +1,134 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                Triple Shift Rotate V2 - Memory Mapped Files
+//
+// This file is NOT meant to be included directly.  It is included by
+// triple-shift-rotate.h, and provides triple_shift_rotate_file().
+//
+// Moving a block of records to the front of a large file would normally mean
+// rewriting the whole range through user space buffers, or into a new file.
+// Since V2 is in-place and needs no more than a small stack buffer, it can
+// instead be run directly upon a shared mapping of the range, and the kernel
+// writes back the pages that it changes.  No second copy of the data is ever
+// made, in memory or on disk.
+//
+// V2 is kind to the page cache as well.  Its ring passes sweep each of the
+// blocks from one end to the other, forwards for ring_positive() and
+// backwards for ring_negative(), and never jump around within them.  The
+// mapping is therefore advised as MADV_SEQUENTIAL, so that the kernel reads
+// ahead aggressively and drops the pages behind the passes first.  The
+// smaller of the two blocks is read by the very first pass, or by the single
+// buffered move that small rotations finish with, so it is also advised as
+// MADV_WILLNEED to have it on its way before the rotation starts.
+//
+// Only the pages that hold the rotated range are ever mapped.  Every byte of
+// that range changes, and nothing outside of it does, so those pages are the
+// dirty range, and only they are handed to msync().  A left or right of 0
+// changes nothing, and nothing is mapped or written at all.
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <unistd.h>
+
+// The flags that triple_shift_rotate_file() takes.  With neither, the changed
+// pages are written back by the kernel in its own time
+#define TSR_FILE_SYNC		1	// Wait for the rotated range to be written
+#define TSR_FILE_ASYNC		2	// Start writing the rotated range back
+
+
+// Rotates the LEFT records of SIZE bytes each at byte OFFSET of the file open
+// for reading and writing as FD, with the RIGHT records that follow them, in
+// place within the file.  FLAGS is 0, TSR_FILE_SYNC or TSR_FILE_ASYNC.  Returns
+// 0 on success, or -1 with errno set if the range could not be mapped or
+// synced.  A range that runs past the end of the file is EINVAL, as touching
+// the mapping past the end would raise SIGBUS, as is one too large to count
+static int
+triple_shift_rotate_file(int fd, off_t offset, size_t left, size_t right, size_t size, int flags)
+{
+	size_t	na, nb, page = sysconf(_SC_PAGESIZE);
+	size_t	head, len, small;
+	struct	stat sb;
+	char	*map, *pa;
+	int	ret = 0;
+
+	// Any of these overflowing would wrap around to a range that passes the
+	// checks below, and then the wrong bytes of the file would be rotated
+	if ((size != 0) && ((left > (SIZE_MAX / size)) || (right > (SIZE_MAX / size)))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	na = left * size, nb = right * size;
+	if (na > (SIZE_MAX - nb)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((na == 0) || (nb == 0))
+		return 0;
+
+	if (fstat(fd, &sb) != 0)
+		return -1;
+
+	if ((offset < 0) || ((size_t)offset > (size_t)sb.st_size) ||
+	    ((na + nb) > ((size_t)sb.st_size - offset))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// mmap() wants a page aligned offset, so map from the start of the page
+	head = offset % page;
+	len = head + na + nb;
+
+	map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset - head);
+	if (map == MAP_FAILED)
+		return -1;
+	pa = map + head;
+
+	// The advice is only a hint, so any failure to take it is of no matter
+	madvise(map, len, MADV_SEQUENTIAL);
+	if (na < nb) {
+		small = (size_t)pa % page;
+		madvise(pa - small, small + na, MADV_WILLNEED);
+	} else {
+		small = (size_t)(pa + na) % page;
+		madvise(pa + na - small, small + nb, MADV_WILLNEED);
+	}
+
+	triple_shift_rotate_v2_bytes(pa, na, nb);
+
+	if (flags & TSR_FILE_SYNC)
+		ret = msync(map, len, MS_SYNC);
+	else if (flags & TSR_FILE_ASYNC)
+		ret = msync(map, len, MS_ASYNC);
+
+	if (munmap(map, len) != 0)
+		ret = -1;
+
+	return ret;
+} // triple_shift_rotate_file
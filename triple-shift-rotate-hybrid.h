@@ -0,0 +1,182 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                          Hybrid rotate() Dispatcher
+//
+// No one rotation algorithm is the fastest everywhere.  Triple Shift V2 wins at
+// the small and very large sizes, but Igor's Bridge and Auxiliary rotations
+// can beat it by 2-3x in between, if they're allowed to malloc() their scratch
+// space.  rotate() picks whichever of triple_shift_rotate_v2(), trinity_rotation(),
+// bridge_rotation() and auxiliary_rotation() is fastest for the given sizes,
+// using a decision table that is indexed by:
+//
+//   Row    - The total number of items, by power of 2
+//   Column - The smaller block as a fraction of the total, being one of
+//            under 1/32, under 1/8, under 1/4, under 3/8 and up to 1/2
+//
+// Each table entry holds both the fastest algorithm overall, and the fastest
+// of the two that need no heap memory at all.  The latter is used whenever the
+// former would need more scratch memory than the caller allows.
+//
+// The default table below was measured on an AVX-512 capable x86-64.  As with
+// the other tunables, `make tsr-config.h` measures a table for the machine it
+// is run upon, and building with TSR_CONFIG set to that header will use it.
+//
+// This header must be included after both rotate.h and triple-shift-rotate.h
+
+#ifndef TRIPLE_SHIFT_ROTATE_HYBRID_H
+#define TRIPLE_SHIFT_ROTATE_HYBRID_H
+
+#if !defined(ROTATE_H) || !defined(TSR_MIN_STREAM_SIZE)
+#error "rotate.h and triple-shift-rotate.h must be included before this file"
+#endif
+
+// The algorithms that rotate() picks from
+enum {
+	TSR_V2,
+	TSR_TRINITY,
+	TSR_BRIDGE,
+	TSR_AUX,
+	TSR_NUM_ALGOS
+};
+
+typedef struct {
+	unsigned char	best;		// Fastest algorithm of all
+	unsigned char	inplace;	// Fastest of TSR_V2 and TSR_TRINITY
+} tsr_hybrid_t;
+
+// Row N covers from 2^N up to 2^(N+1) items, with the last row covering all
+// sizes above that.  See tsr_hybrid_col() for the column boundaries
+#define TSR_HYBRID_ROWS		22
+#define TSR_HYBRID_COLS		5
+
+#ifndef TSR_HYBRID_TABLE
+#define TSR_HYBRID_TABLE { \
+	/* 2^0  */ {{TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^1  */ {{TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_TRINITY, TSR_TRINITY}}, \
+	/* 2^2  */ {{TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}}, \
+	/* 2^3  */ {{TSR_TRINITY, TSR_TRINITY}, {TSR_TRINITY, TSR_TRINITY}, {TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}, {TSR_TRINITY, TSR_TRINITY}}, \
+	/* 2^4  */ {{TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}, {TSR_TRINITY, TSR_TRINITY}, {TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}}, \
+	/* 2^5  */ {{TSR_V2, TSR_V2}, {TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^6  */ {{TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^7  */ {{TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^8  */ {{TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}}, \
+	/* 2^9  */ {{TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}}, \
+	/* 2^10 */ {{TSR_V2, TSR_V2}, {TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}}, \
+	/* 2^11 */ {{TSR_V2, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}}, \
+	/* 2^12 */ {{TSR_AUX, TSR_V2}, {TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_BRIDGE, TSR_V2}}, \
+	/* 2^13 */ {{TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_BRIDGE, TSR_V2}}, \
+	/* 2^14 */ {{TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}}, \
+	/* 2^15 */ {{TSR_AUX, TSR_TRINITY}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}}, \
+	/* 2^16 */ {{TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_AUX, TSR_TRINITY}}, \
+	/* 2^17 */ {{TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^18 */ {{TSR_AUX, TSR_V2}, {TSR_BRIDGE, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^19 */ {{TSR_AUX, TSR_V2}, {TSR_AUX, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^20 */ {{TSR_AUX, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+	/* 2^21 */ {{TSR_BRIDGE, TSR_V2}, {TSR_TRINITY, TSR_TRINITY}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}, {TSR_V2, TSR_V2}}, \
+}
+#endif
+
+static const tsr_hybrid_t tsr_hybrid_table[TSR_HYBRID_ROWS][TSR_HYBRID_COLS] = TSR_HYBRID_TABLE;
+
+
+// Returns the table row for a rotation of N items, where N > 0
+static inline size_t
+tsr_hybrid_row(size_t n)
+{
+	size_t	row = (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(n);
+
+	return (row < TSR_HYBRID_ROWS) ? row : TSR_HYBRID_ROWS - 1;
+} // tsr_hybrid_row
+
+
+// Returns the table column for a rotation of N items, where the smaller of the
+// two blocks is M items.  The column boundaries are in 64ths of N
+static inline size_t
+tsr_hybrid_col(size_t m, size_t n)
+{
+	static const unsigned char bounds[TSR_HYBRID_COLS - 1] = {2, 8, 16, 24};
+	size_t	q = (m * 64) / n, col = 0;
+
+	while ((col < (TSR_HYBRID_COLS - 1)) && (q >= bounds[col]))
+		col++;
+
+	return col;
+} // tsr_hybrid_col
+
+
+// Returns the number of bytes that ALGO will malloc() to rotate LEFT and RIGHT
+// items.  These mirror the allocations made within rotate.h
+static inline size_t
+tsr_hybrid_scratch(int algo, size_t left, size_t right)
+{
+	size_t	m = (left < right) ? left : right;
+	size_t	d = (left < right) ? right - left : left - right;
+
+	switch (algo) {
+	case TSR_AUX:
+		return m * sizeof(uintptr_t);
+	case TSR_BRIDGE:
+		if (d == 0)
+			return sizeof(uintptr_t);
+		return ((d < m) ? d : m) * sizeof(uintptr_t);
+	default:
+		return 0;
+	}
+} // tsr_hybrid_scratch
+
+
+// Rotates LEFT items at ARRAY with the RIGHT items that follow them, with the
+// fastest algorithm that needs no more than SCRATCH bytes of heap memory.  A
+// SCRATCH of 0 guarantees a fully in-place rotation with no allocations
+static void
+rotate(uintptr_t *array, size_t left, size_t right, size_t scratch)
+{
+	size_t	n = left + right, m = (left < right) ? left : right;
+	const tsr_hybrid_t *h;
+	int	algo;
+
+	if (m == 0)
+		return;
+
+	h = &tsr_hybrid_table[tsr_hybrid_row(n)][tsr_hybrid_col(m, n)];
+
+	algo = h->best;
+	if (tsr_hybrid_scratch(algo, left, right) > scratch)
+		algo = h->inplace;
+
+	switch (algo) {
+	case TSR_TRINITY:
+		return trinity_rotation(array, left, right);
+	case TSR_BRIDGE:
+		return bridge_rotation(array, left, right);
+	case TSR_AUX:
+		return auxiliary_rotation(array, left, right);
+	default:
+		return triple_shift_rotate_v2(array, left, right);
+	}
+} // rotate
+
+#endif // TRIPLE_SHIFT_ROTATE_HYBRID_H
@@ -0,0 +1,102 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                        Element Move Accounting
+//
+// When built with TSR_COUNT_MOVES defined, the rotations in triple-shift-rotate.h
+// and those of rotate.h that rotate.c benchmarks count the memory traffic that
+// they make, in bytes, as:
+//
+//   reads  - Items loaded by the element-wise loops and SIMD kernels
+//   writes - Items stored by the element-wise loops and SIMD kernels
+//   copied - Bytes moved by memcpy() and memmove() calls
+//
+// A rotation must read and write every item at least once, so comparing the
+// total against 2 * N * item size shows how close an algorithm comes to the
+// least possible traffic.  The loops are not touched at all.  Each one instead
+// adds the count for all of its items up front via TSR_MOVES(), so the counted
+// build still runs the same code.  memcpy() and memmove() are wrapped to count
+// their bytes, except for those of a constant size.  Those are the 8 byte and
+// smaller copies used to load and store items without alignment worries, and
+// which the loops that they're in already count.
+//
+// The counters are updated atomically, as the multi-threaded rotations update
+// them from every thread.  Without TSR_COUNT_MOVES, none of this costs a thing
+
+#ifndef TRIPLE_SHIFT_ROTATE_MOVES_H
+#define TRIPLE_SHIFT_ROTATE_MOVES_H
+
+#ifdef TSR_COUNT_MOVES
+
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+	size_t	reads;
+	size_t	writes;
+	size_t	copied;
+} tsr_moves_t;
+
+static tsr_moves_t tsr_moves;
+
+#define TSR_MOVES(r, w)								\
+	(__atomic_fetch_add(&tsr_moves.reads, (r), __ATOMIC_RELAXED),		\
+	 __atomic_fetch_add(&tsr_moves.writes, (w), __ATOMIC_RELAXED))
+
+
+static inline void *
+tsr_moves_memcpy(void *dst, const void *src, size_t n)
+{
+	__atomic_fetch_add(&tsr_moves.copied, n, __ATOMIC_RELAXED);
+	return __builtin_memcpy(dst, src, n);
+} // tsr_moves_memcpy
+
+
+static inline void *
+tsr_moves_memmove(void *dst, const void *src, size_t n)
+{
+	__atomic_fetch_add(&tsr_moves.copied, n, __ATOMIC_RELAXED);
+	return __builtin_memmove(dst, src, n);
+} // tsr_moves_memmove
+
+
+#undef memcpy
+#undef memmove
+
+#define memcpy(d, s, n)								\
+	(__builtin_constant_p(n) ? __builtin_memcpy((d), (s), (n))		\
+	                         : tsr_moves_memcpy((d), (s), (n)))
+
+#define memmove(d, s, n)							\
+	(__builtin_constant_p(n) ? __builtin_memmove((d), (s), (n))		\
+	                         : tsr_moves_memmove((d), (s), (n)))
+
+#else
+
+#define TSR_MOVES(r, w)	((void)0)
+
+#endif // TSR_COUNT_MOVES
+
+#endif // TRIPLE_SHIFT_ROTATE_MOVES_H
@@ -0,0 +1,475 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                  Triple Shift Rotate V2 - Multi-Threaded
+//
+// This file is NOT meant to be included directly.  It is included by
+// triple-shift-rotate.h, and provides triple_shift_rotate_v2_mt().
+//
+// Once an array is much larger than the CPU caches, a rotation is entirely
+// memory bandwidth bound, and a single core cannot saturate the bandwidth of
+// a modern CPU socket.  The ring passes of V2 split very nicely across many
+// threads though.  Consider the ring_positive() loop:
+//
+//	for ( ; na > no; pa += no, na -= no)
+//		ring_positive(pa, pb, pe - na, no);
+//
+// Every pass rotates the same O block with a fresh part of the A and B blocks.
+// If a thread is handed the same slice of O in every pass, then it will only
+// ever touch its own slice of O, along with parts of A and B that no other
+// thread ever touches.  So the threads are fully independent for the entire
+// ring loop, including the final partial pass, and need no synchronisation
+// with each other until the loop is done.
+//
+// The large memmove() in rotate_small() is also split across the threads. The
+// problem there is that each thread's chunk of the move overwrites the edge
+// of its neighbour's source chunk, so it is done in two phases.  First every
+// thread saves the edge of its source that its neighbour will overwrite, and
+// then every thread moves the rest of its chunk and puts the saved bytes back
+// into their final position.
+//
+// Work is handed out to a persistent pool of worker threads, which is started
+// by tsr_pool_init().  Rotations of fewer than tsr_mt_threshold bytes are not
+// worth the cost of waking the pool, and run on the calling thread.  Only one
+// thread may use the pool at a time.  If the pool is busy, or has not been
+// started, then triple_shift_rotate_v2_mt() just runs single threaded.
+
+#include <pthread.h>
+#include <unistd.h>
+
+// The maximum number of threads, including the caller, that a rotation will
+// be split across
+#define TSR_MAX_THREADS		64
+
+// Rotations of at least this many bytes will be split across the thread pool
+static size_t	tsr_mt_threshold = 1024 * 1024;
+
+typedef void tsr_pool_job_t(void *arg, int part, int nparts);
+
+static struct {
+	pthread_mutex_t	lock;
+	pthread_mutex_t	busy;		// Held by the thread using the pool
+	pthread_cond_t	wake;
+	pthread_cond_t	done;
+	pthread_t	threads[TSR_MAX_THREADS];
+	int		nthreads;	// Number of workers, not counting the caller
+	int		running;	// Number of workers yet to finish the job
+	unsigned	generation;	// Incremented for every new job
+	bool		shutdown;
+	tsr_pool_job_t	*job;
+	void		*arg;
+	int		nparts;
+} tsr_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.busy = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+
+//------------------------------------------------------------------------------
+//                             Worker Thread Pool
+//------------------------------------------------------------------------------
+
+static void *
+tsr_pool_worker(void *id)
+{
+	int	part = (int)(intptr_t)id + 1;
+	unsigned seen = 0;
+
+	pthread_mutex_lock(&tsr_pool.lock);
+	for (;;) {
+		while (tsr_pool.generation == seen && !tsr_pool.shutdown)
+			pthread_cond_wait(&tsr_pool.wake, &tsr_pool.lock);
+
+		if (tsr_pool.shutdown)
+			break;
+
+		seen = tsr_pool.generation;
+		pthread_mutex_unlock(&tsr_pool.lock);
+
+		if (part < tsr_pool.nparts)
+			tsr_pool.job(tsr_pool.arg, part, tsr_pool.nparts);
+
+		pthread_mutex_lock(&tsr_pool.lock);
+		if (--tsr_pool.running == 0)
+			pthread_cond_signal(&tsr_pool.done);
+	}
+	pthread_mutex_unlock(&tsr_pool.lock);
+
+	return NULL;
+} // tsr_pool_worker
+
+
+// Stops all of the worker threads in the pool.  The caller must hold
+// tsr_pool.busy
+static void
+tsr_pool_stop(void)
+{
+	pthread_mutex_lock(&tsr_pool.lock);
+	tsr_pool.shutdown = true;
+	pthread_cond_broadcast(&tsr_pool.wake);
+	pthread_mutex_unlock(&tsr_pool.lock);
+
+	for (int i = 0; i < tsr_pool.nthreads; i++)
+		pthread_join(tsr_pool.threads[i], NULL);
+
+	// With no workers left, the generation can safely restart from 0,
+	// which is where newly started workers expect it to be
+	tsr_pool.nthreads = 0;
+	tsr_pool.generation = 0;
+	tsr_pool.shutdown = false;
+} // tsr_pool_stop
+
+
+// Stops all of the worker threads in the pool
+static void
+tsr_pool_destroy(void)
+{
+	pthread_mutex_lock(&tsr_pool.busy);
+	tsr_pool_stop();
+	pthread_mutex_unlock(&tsr_pool.busy);
+} // tsr_pool_destroy
+
+
+// Starts a pool such that rotations are split across NTHREADS threads in total,
+// including the calling thread.  An NTHREADS of 0 uses every online CPU.  Any
+// existing pool is stopped first.  Returns the number of threads in use.  The
+// whole restart is done while holding tsr_pool.busy, so that neither another
+// tsr_pool_init() nor a rotation can see the pool half way through it
+static int
+tsr_pool_init(int nthreads)
+{
+	int	count;
+
+	if (nthreads <= 0)
+		nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (nthreads > TSR_MAX_THREADS)
+		nthreads = TSR_MAX_THREADS;
+
+	pthread_mutex_lock(&tsr_pool.busy);
+	if (tsr_pool.nthreads > 0)
+		tsr_pool_stop();
+
+	for (int i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&tsr_pool.threads[i], NULL, tsr_pool_worker, (void *)(intptr_t)i))
+			break;
+		tsr_pool.nthreads++;
+	}
+	count = tsr_pool.nthreads + 1;
+	pthread_mutex_unlock(&tsr_pool.busy);
+
+	return count;
+} // tsr_pool_init
+
+
+// Runs JOB as NPARTS parts across the pool, with the caller running part 0,
+// and waits for all parts to complete.  The caller must hold tsr_pool.busy
+static void
+tsr_pool_run(tsr_pool_job_t *job, void *arg, int nparts)
+{
+	pthread_mutex_lock(&tsr_pool.lock);
+	tsr_pool.job = job;
+	tsr_pool.arg = arg;
+	tsr_pool.nparts = nparts;
+	tsr_pool.running = tsr_pool.nthreads;
+	tsr_pool.generation++;
+	pthread_cond_broadcast(&tsr_pool.wake);
+	pthread_mutex_unlock(&tsr_pool.lock);
+
+	job(arg, 0, nparts);
+
+	pthread_mutex_lock(&tsr_pool.lock);
+	while (tsr_pool.running > 0)
+		pthread_cond_wait(&tsr_pool.done, &tsr_pool.lock);
+	pthread_mutex_unlock(&tsr_pool.lock);
+} // tsr_pool_run
+
+
+//------------------------------------------------------------------------------
+//                               Parallel Jobs
+//------------------------------------------------------------------------------
+
+// Returns the offset at which PART of NPARTS begins, when splitting NUM bytes.
+// Offsets are kept to multiples of 64 bytes, so that threads don't contend
+// over the same cache lines of O
+static inline size_t
+tsr_mt_split(size_t num, int part, int nparts)
+{
+	if (part >= nparts)
+		return num;
+
+	return ((num / nparts) * part) & ~(size_t)63;
+} // tsr_mt_split
+
+
+typedef struct {
+	char	*pa, *pb, *pe;
+	size_t	na, nb, no;
+	char	(*saved)[STREAM_BUF_SIZE];	// One edge buffer per part
+} tsr_mt_args_t;
+
+
+// Runs the part's slice of every ring_positive() pass.  See the V2 driver
+static void
+tsr_mt_ring_positive(void *arg, int part, int nparts)
+{
+	tsr_mt_args_t *r = arg;
+	size_t	s = tsr_mt_split(r->no, part, nparts), e = tsr_mt_split(r->no, part + 1, nparts);
+	size_t	na = r->na, no = r->no;
+	char	*pa = r->pa, *pb = r->pb, *pe = r->pe;
+
+	if (s == e)
+		return;
+
+	for ( ; na > no; pa += no, na -= no)
+		tsr_simd->ring_positive(pa + s, pb + s, pe - na + s, e - s);
+
+	if (na > s)
+		tsr_simd->ring_positive(pa + s, pb + s, pe - na + s, (na < e ? na : e) - s);
+} // tsr_mt_ring_positive
+
+
+// Runs the part's slice of every ring_negative() pass.  As ring_negative()
+// works backwards from the ends of the blocks, slices are taken from the ends
+static void
+tsr_mt_ring_negative(void *arg, int part, int nparts)
+{
+	tsr_mt_args_t *r = arg;
+	size_t	s = tsr_mt_split(r->no, part, nparts), e = tsr_mt_split(r->no, part + 1, nparts);
+	size_t	nb = r->nb, no = r->no;
+	char	*pa = r->pa, *pb = r->pb, *pe = r->pe;
+
+	if (s == e)
+		return;
+
+	for ( ; nb > no; pe -= no, nb -= no)
+		tsr_simd->ring_negative(pa + nb - s, pb - s, pe - s, e - s);
+
+	if (nb > s)
+		tsr_simd->ring_negative(pa + nb - s, pb - s, pe - s, (nb < e ? nb : e) - s);
+} // tsr_mt_ring_negative
+
+
+static void
+tsr_mt_swap(void *arg, int part, int nparts)
+{
+	tsr_mt_args_t *r = arg;
+	size_t	s = tsr_mt_split(r->na, part, nparts), e = tsr_mt_split(r->na, part + 1, nparts);
+
+	tsr_simd->two_way_swap_block(r->pa + s, r->pb + s, e - s);
+} // tsr_mt_swap
+
+
+// For the memmove() of rotate_small(), the source is the larger block, which
+// is moved by the size of the smaller block, ND.  Each part's chunk of the
+// source is [s, e).  When moving down, the last ND bytes of a chunk get
+// overwritten by the next part, so are saved first.  When moving up, the
+// first ND bytes of a chunk get overwritten by the previous part instead.
+static void
+tsr_mt_move_save(void *arg, int part, int nparts)
+{
+	tsr_mt_args_t *r = arg;
+	size_t	ns = (r->na < r->nb) ? r->nb : r->na, nd = r->no;
+	size_t	s = tsr_mt_split(ns, part, nparts), e = tsr_mt_split(ns, part + 1, nparts);
+	char	*src = (r->na < r->nb) ? r->pb : r->pa;
+
+	if (r->na < r->nb) {
+		if (part < nparts - 1)
+			memcpy(r->saved[part], src + e - nd, nd);
+	} else {
+		if (part > 0)
+			memcpy(r->saved[part], src + s, nd);
+	}
+} // tsr_mt_move_save
+
+
+static void
+tsr_mt_move(void *arg, int part, int nparts)
+{
+	tsr_mt_args_t *r = arg;
+	size_t	ns = (r->na < r->nb) ? r->nb : r->na, nd = r->no;
+	size_t	s = tsr_mt_split(ns, part, nparts), e = tsr_mt_split(ns, part + 1, nparts);
+
+	if (r->na < r->nb) {
+		// Moving down by ND
+		char	*src = r->pb, *dst = r->pb - nd;
+
+		if (part < nparts - 1) {
+			memmove(dst + s, src + s, e - s - nd);
+			memcpy(dst + e - nd, r->saved[part], nd);
+		} else {
+			memmove(dst + s, src + s, e - s);
+		}
+	} else {
+		// Moving up by ND
+		char	*src = r->pa, *dst = r->pa + nd;
+
+		if (part > 0) {
+			memmove(dst + s + nd, src + s + nd, e - s - nd);
+			memcpy(dst + s, r->saved[part], nd);
+		} else {
+			memmove(dst + s, src + s, e - s);
+		}
+	}
+} // tsr_mt_move
+
+
+// The parallel equivalent of rotate_small() where the smaller block is ND
+// bytes, and is no larger than STREAM_BUF_SIZE
+static void
+tsr_mt_rotate_small(tsr_mt_args_t *r, int nparts)
+{
+	size_t	na = r->na, nb = r->nb;
+	char	_buf[STREAM_BUF_SIZE];
+	void	*buf = (void *)_buf;
+
+	// Every part must be larger than the distance moved, so that only
+	// adjacent parts ever overwrite each other
+	if (nparts > (int)((na + nb) / (4 * STREAM_BUF_SIZE)))
+		nparts = (int)((na + nb) / (4 * STREAM_BUF_SIZE));
+	if (nparts < 1)
+		nparts = 1;
+
+	if (na < nb) {
+		r->no = na;
+		memcpy(buf, r->pa, na);
+		tsr_pool_run(tsr_mt_move_save, r, nparts);
+		tsr_pool_run(tsr_mt_move, r, nparts);
+		memcpy(r->pa + nb, buf, na);
+	} else {
+		r->no = nb;
+		memcpy(buf, r->pb, nb);
+		tsr_pool_run(tsr_mt_move_save, r, nparts);
+		tsr_pool_run(tsr_mt_move, r, nparts);
+		memcpy(r->pa, buf, nb);
+	}
+} // tsr_mt_rotate_small
+
+
+//------------------------------------------------------------------------------
+//                     Multi-Threaded Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// The V2 driver, counting in bytes, with the ring loops run across the pool.
+// Once the rotation space has collapsed below tsr_mt_threshold, the remainder
+// of the rotation is handed to the single threaded driver
+static void
+triple_shift_rotate_v2_mt_bytes(char *pa, size_t na, size_t nb)
+{
+	static char saved[TSR_MAX_THREADS][STREAM_BUF_SIZE];
+	tsr_mt_args_t r = { .saved = saved };
+	int	nparts;
+
+	if ((na + nb) < tsr_mt_threshold)
+		return triple_shift_rotate_v2_bytes(pa, na, nb);
+
+	if (pthread_mutex_trylock(&tsr_pool.busy) != 0)
+		return triple_shift_rotate_v2_bytes(pa, na, nb);
+
+	// The pool can only be resized while busy is held, so it's only safe
+	// to count its threads now
+	nparts = tsr_pool.nthreads + 1;
+	if (nparts == 1) {
+		pthread_mutex_unlock(&tsr_pool.busy);
+		return triple_shift_rotate_v2_bytes(pa, na, nb);
+	}
+
+	for (char *pb = pa + na, *pe = pb + nb; na; nb = pe - pb, na = pb - pa) {
+		r.pa = pa, r.pb = pb, r.pe = pe, r.na = na, r.nb = nb;
+
+		if ((na + nb) < tsr_mt_threshold)
+			break;
+
+		if (na < nb) {
+			size_t	no = nb - na;
+
+			if (na <= MIN_STREAM_SIZE) {
+				tsr_mt_rotate_small(&r, nparts);
+				na = 0;
+				break;
+			}
+
+			if (no <= MIN_STREAM_SIZE)
+				break;
+
+			r.no = no;
+			tsr_pool_run(tsr_mt_ring_positive, &r, nparts);
+
+			// Skip over all of the passes just run in parallel
+			na -= ((na - 1) / no) * no;
+			pa = pb,  pe = pb + no,  pb += na;
+		} else if (na == nb) {
+			tsr_pool_run(tsr_mt_swap, &r, nparts);
+			na = 0;
+			break;
+		} else if (nb == 0) {
+			break;
+		} else {
+			size_t	no = na - nb;
+
+			if (nb <= MIN_STREAM_SIZE) {
+				tsr_mt_rotate_small(&r, nparts);
+				na = 0;
+				break;
+			}
+
+			if (no <= MIN_STREAM_SIZE)
+				break;
+
+			r.no = no;
+			tsr_pool_run(tsr_mt_ring_negative, &r, nparts);
+
+			nb -= ((nb - 1) / no) * no;
+			pe = pb,  pa = pb - no,  pb -= nb;
+		}
+	}
+
+	pthread_mutex_unlock(&tsr_pool.busy);
+
+	// Finish off whatever remains on this thread
+	if (na)
+		triple_shift_rotate_v2_bytes(pa, na, nb);
+} // triple_shift_rotate_v2_mt_bytes
+
+
+// Rotates NA items of SIZE bytes each at BASE with the NB items that follow,
+// splitting the work across the thread pool for large rotations
+static void
+triple_shift_rotate_v2_mt_sized(void *base, size_t na, size_t nb, size_t size)
+{
+	triple_shift_rotate_v2_mt_bytes(base, na * size, nb * size);
+} // triple_shift_rotate_v2_mt_sized
+
+
+static void
+triple_shift_rotate_v2_mt(uintptr_t *pa, size_t na, size_t nb)
+{
+	triple_shift_rotate_v2_mt_bytes((char *)pa, na * sizeof(*pa), nb * sizeof(*pa));
+} // triple_shift_rotate_v2_mt
+
+
+#undef TSR_MAX_THREADS
@@ -0,0 +1,655 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                  Triple Shift Rotate V2 - SIMD Kernel Template
+//
+// This file is NOT meant to be included directly.  It is included once per
+// instruction set by triple-shift-rotate-simd.h to stamp out hand vectorised
+// copies of the byte-wise kernels, along with a tsr_simd_ops_t table of them.
+// Before including, define:
+//
+//   TSR_VEC            - The vector register type (eg. __m256i)
+//   TSR_VLOAD(p)       - Unaligned load of a TSR_VEC from char pointer P
+//   TSR_VSTORE(p, v)   - Unaligned store of TSR_VEC V to char pointer P
+//   TSR_VSTREAM(p, v)  - Non-temporal store of TSR_VEC V to aligned pointer P
+//   TSR_VFROM128(x)    - The __m128i X widened to a TSR_VEC, upper bits undefined
+//   TSR_VTO128(v)      - The low 128 bits of TSR_VEC V, as an __m128i
+//   TSR_TARGET         - Function attributes enabling the instruction set
+//   TSR_SUFFIX         - The suffix appended to every generated name
+//   TSR_ISA_NAME       - The name of the instruction set, as a string
+//
+// The kernels run the vector body over as many whole vectors as fit.  The
+// bridges then hand the remaining (less than one vector's worth of) bytes to
+// the scalar tsr_scalar_*() kernels, while the swap and ring kernels finish
+// with a vector that overlaps the last whole one, and only hand blocks of less
+// than a vector to the scalar kernels.  All of the above macros are #undef'd
+// at the end.
+
+#if !defined(TSR_VEC) || !defined(TSR_SUFFIX)
+#error "TSR_VEC and TSR_SUFFIX must be defined before including this file"
+#endif
+
+#define TSR_PASTE(name, suffix)  name##suffix
+#define TSR_EXPAND(name, suffix) TSR_PASTE(name, suffix)
+#define TSR_FN(name)             TSR_EXPAND(name, TSR_SUFFIX)
+
+#define TSR_VSIZE                sizeof(TSR_VEC)
+
+// Each bridge kernel counts only its whole vectors, as the scalar kernel that
+// finishes off the rest counts those bytes itself.
+//
+// Every kernel is written once, as an always inlined body that also takes the
+// prefetch distance DIST, in bytes.  The plain kernels pass a DIST of 0, which
+// the compiler then strips all of the prefetches out of, while the _far
+// kernels used on arrays larger than the LLC pass tsr_prefetch_distance.  Each
+// stream is prefetched DIST bytes ahead of where it is being loaded from, in
+// the direction that it is being walked
+
+#define TSR_PREFETCH(p)		_mm_prefetch((const char *)(p), _MM_HINT_T0)
+
+// The swap and ring loops are aligned to one of the blocks that they walk, so
+// that its vectors never straddle a cache line.  The blocks are rarely aligned
+// to each other, so they can't all be.  Each block is both loaded from and
+// stored to at the same offsets though, so aligning any one of them saves as
+// much as aligning any other, unless two of them share their alignment, as
+// then aligning one aligns both.  The bytes before the first aligned vector,
+// and after the last whole one, are each done as a single unaligned vector at
+// either end.  Those are loaded before the loop runs, and stored after, so the
+// loop never loads what they store, and what they store over the loop's bytes
+// is just what the loop stored there anyway
+
+// The misalignment of whichever of the three blocks the ring loops align to
+TSR_TARGET static inline __attribute__((always_inline)) size_t
+TSR_FN(tsr_misalign)(const char *pa, const char *po, const char *pb)
+{
+	size_t	ma = (uintptr_t)pa % TSR_VSIZE, mo = (uintptr_t)po % TSR_VSIZE;
+
+	return (mo == ((uintptr_t)pb % TSR_VSIZE)) ? mo : ma;
+} // tsr_misalign
+
+
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_two_way_swap_block_at)(char * restrict pa, char * restrict pb, size_t num, size_t dist)
+{
+	if (num < TSR_VSIZE)
+		return tsr_scalar_two_way_swap_block(pa, pb, num);
+
+	TSR_MOVES(2 * num, 2 * num);
+
+	size_t	peel = (TSR_VSIZE - ((uintptr_t)pa % TSR_VSIZE)) % TSR_VSIZE;
+	TSR_VEC	ha = TSR_VLOAD(pa), hb = TSR_VLOAD(pb);
+	TSR_VEC	ta = TSR_VLOAD(pa + num - TSR_VSIZE), tb = TSR_VLOAD(pb + num - TSR_VSIZE);
+	char	*sa = pa, *sb = pb, *ea = pa + num - TSR_VSIZE, *eb = pb + num - TSR_VSIZE;
+
+	for (pa += peel, pb += peel, num -= peel; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		if (dist)
+			TSR_PREFETCH(pa + dist), TSR_PREFETCH(pb + dist);
+
+		TSR_VEC	a = TSR_VLOAD(pa), b = TSR_VLOAD(pb);
+
+		TSR_VSTORE(pa, b), TSR_VSTORE(pb, a);
+		pa += TSR_VSIZE, pb += TSR_VSIZE;
+	}
+	TSR_VSTORE(sa, hb), TSR_VSTORE(sb, ha);
+	TSR_VSTORE(ea, tb), TSR_VSTORE(eb, ta);
+} // tsr_two_way_swap_block_at
+
+
+// The loads of both PA and PB must be done before either store, as the PC
+// block trails behind the PB block and may overlap the part just loaded
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_bridge_up_at)(char * restrict pa, char *pb, char *pc, size_t num, size_t dist)
+{
+	TSR_MOVES(2 * (num - (num % TSR_VSIZE)), 2 * (num - (num % TSR_VSIZE)));
+
+	for ( ; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		if (dist)
+			TSR_PREFETCH(pa + dist), TSR_PREFETCH(pb + dist), TSR_PREFETCH(pc + dist);
+
+		TSR_VEC	a = TSR_VLOAD(pa), b = TSR_VLOAD(pb);
+
+		TSR_VSTORE(pc, a), TSR_VSTORE(pa, b);
+		pa += TSR_VSIZE, pb += TSR_VSIZE, pc += TSR_VSIZE;
+	}
+	tsr_scalar_bridge_up(pa, pb, pc, num);
+} // tsr_bridge_up_at
+
+
+// Works downwards from the ends of the blocks.  As with bridge_up, both loads
+// must precede the stores, as PE leads PD and may overlap the loaded part
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_bridge_down_at)(char * restrict pc, char *pd, char *pe, size_t num, size_t dist)
+{
+	TSR_MOVES(2 * (num - (num % TSR_VSIZE)), 2 * (num - (num % TSR_VSIZE)));
+
+	for ( ; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		pc -= TSR_VSIZE, pd -= TSR_VSIZE, pe -= TSR_VSIZE;
+
+		if (dist)
+			TSR_PREFETCH(pc - dist), TSR_PREFETCH(pd - dist), TSR_PREFETCH(pe - dist);
+
+		TSR_VEC	c = TSR_VLOAD(pc), d = TSR_VLOAD(pd);
+
+		TSR_VSTORE(pe, c), TSR_VSTORE(pc, d);
+	}
+	tsr_scalar_bridge_down(pc, pd, pe, num);
+} // tsr_bridge_down_at
+
+
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_ring_positive_at)(char * restrict pa, char * restrict po, char * restrict pb, size_t num, size_t dist)
+{
+	if (num < TSR_VSIZE)
+		return tsr_scalar_ring_positive(pa, po, pb, num);
+
+	TSR_MOVES(3 * num, 3 * num);
+
+	size_t	peel = (TSR_VSIZE - TSR_FN(tsr_misalign)(pa, po, pb)) % TSR_VSIZE;
+	TSR_VEC	ha = TSR_VLOAD(pa), ho = TSR_VLOAD(po), hb = TSR_VLOAD(pb);
+	TSR_VEC	ta = TSR_VLOAD(pa + num - TSR_VSIZE), to = TSR_VLOAD(po + num - TSR_VSIZE);
+	TSR_VEC	tb = TSR_VLOAD(pb + num - TSR_VSIZE);
+	char	*sa = pa, *so = po, *sb = pb;
+
+	for (pa += peel, po += peel, pb += peel, num -= peel; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		if (dist)
+			TSR_PREFETCH(pa + dist), TSR_PREFETCH(po + dist), TSR_PREFETCH(pb + dist);
+
+		TSR_VEC	a = TSR_VLOAD(pa), o = TSR_VLOAD(po), b = TSR_VLOAD(pb);
+
+		TSR_VSTORE(pa, o), TSR_VSTORE(po, b), TSR_VSTORE(pb, a);
+		pa += TSR_VSIZE, po += TSR_VSIZE, pb += TSR_VSIZE;
+	}
+	pa -= TSR_VSIZE - num, po -= TSR_VSIZE - num, pb -= TSR_VSIZE - num;
+
+	TSR_VSTORE(sa, ho), TSR_VSTORE(so, hb), TSR_VSTORE(sb, ha);
+	TSR_VSTORE(pa, to), TSR_VSTORE(po, tb), TSR_VSTORE(pb, ta);
+} // tsr_ring_positive_at
+
+
+// Works downwards from the ends of the blocks, and so peels from the ends, with
+// the vectors at the starts of the blocks as the tail
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_ring_negative_at)(char * restrict pa, char * restrict po, char * restrict pb, size_t num, size_t dist)
+{
+	if (num < TSR_VSIZE)
+		return tsr_scalar_ring_negative(pa, po, pb, num);
+
+	TSR_MOVES(3 * num, 3 * num);
+
+	size_t	peel = TSR_FN(tsr_misalign)(pa, po, pb);
+	TSR_VEC	ha = TSR_VLOAD(pa - TSR_VSIZE), ho = TSR_VLOAD(po - TSR_VSIZE), hb = TSR_VLOAD(pb - TSR_VSIZE);
+	TSR_VEC	ta = TSR_VLOAD(pa - num), to = TSR_VLOAD(po - num), tb = TSR_VLOAD(pb - num);
+	char	*ea = pa - TSR_VSIZE, *eo = po - TSR_VSIZE, *eb = pb - TSR_VSIZE;
+
+	for (pa -= peel, po -= peel, pb -= peel, num -= peel; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		pa -= TSR_VSIZE, po -= TSR_VSIZE, pb -= TSR_VSIZE;
+
+		if (dist)
+			TSR_PREFETCH(pa - dist), TSR_PREFETCH(po - dist), TSR_PREFETCH(pb - dist);
+
+		TSR_VEC	a = TSR_VLOAD(pa), o = TSR_VLOAD(po), b = TSR_VLOAD(pb);
+
+		TSR_VSTORE(pb, o), TSR_VSTORE(po, a), TSR_VSTORE(pa, b);
+	}
+	pa -= num, po -= num, pb -= num;
+
+	TSR_VSTORE(eb, ho), TSR_VSTORE(eo, ha), TSR_VSTORE(ea, hb);
+	TSR_VSTORE(pb, to), TSR_VSTORE(po, ta), TSR_VSTORE(pa, tb);
+} // tsr_ring_negative_at
+
+
+// The plain kernels, and the _far kernels used on arrays larger than the LLC
+
+TSR_TARGET static void
+TSR_FN(tsr_two_way_swap_block)(char * restrict pa, char * restrict pb, size_t num)
+{
+	TSR_FN(tsr_two_way_swap_block_at)(pa, pb, num, 0);
+} // tsr_two_way_swap_block
+
+
+TSR_TARGET static void
+TSR_FN(tsr_two_way_swap_block_far)(char * restrict pa, char * restrict pb, size_t num)
+{
+	TSR_FN(tsr_two_way_swap_block_at)(pa, pb, num, tsr_prefetch_distance);
+} // tsr_two_way_swap_block_far
+
+
+TSR_TARGET static void
+TSR_FN(tsr_bridge_up)(char * restrict pa, char *pb, char *pc, size_t num)
+{
+	TSR_FN(tsr_bridge_up_at)(pa, pb, pc, num, 0);
+} // tsr_bridge_up
+
+
+TSR_TARGET static void
+TSR_FN(tsr_bridge_up_far)(char * restrict pa, char *pb, char *pc, size_t num)
+{
+	TSR_FN(tsr_bridge_up_at)(pa, pb, pc, num, tsr_prefetch_distance);
+} // tsr_bridge_up_far
+
+
+TSR_TARGET static void
+TSR_FN(tsr_bridge_down)(char * restrict pc, char *pd, char *pe, size_t num)
+{
+	TSR_FN(tsr_bridge_down_at)(pc, pd, pe, num, 0);
+} // tsr_bridge_down
+
+
+TSR_TARGET static void
+TSR_FN(tsr_bridge_down_far)(char * restrict pc, char *pd, char *pe, size_t num)
+{
+	TSR_FN(tsr_bridge_down_at)(pc, pd, pe, num, tsr_prefetch_distance);
+} // tsr_bridge_down_far
+
+
+TSR_TARGET static void
+TSR_FN(tsr_ring_positive)(char * restrict pa, char * restrict po, char * restrict pb, size_t num)
+{
+	TSR_FN(tsr_ring_positive_at)(pa, po, pb, num, 0);
+} // tsr_ring_positive
+
+
+TSR_TARGET static void
+TSR_FN(tsr_ring_positive_far)(char * restrict pa, char * restrict po, char * restrict pb, size_t num)
+{
+	TSR_FN(tsr_ring_positive_at)(pa, po, pb, num, tsr_prefetch_distance);
+} // tsr_ring_positive_far
+
+
+TSR_TARGET static void
+TSR_FN(tsr_ring_negative)(char * restrict pa, char * restrict po, char * restrict pb, size_t num)
+{
+	TSR_FN(tsr_ring_negative_at)(pa, po, pb, num, 0);
+} // tsr_ring_negative
+
+
+TSR_TARGET static void
+TSR_FN(tsr_ring_negative_far)(char * restrict pa, char * restrict po, char * restrict pb, size_t num)
+{
+	TSR_FN(tsr_ring_negative_at)(pa, po, pb, num, tsr_prefetch_distance);
+} // tsr_ring_negative_far
+
+
+// The non-temporal stores need DST to be vector aligned, so the bytes up to the
+// first vector boundary, and the tail of less than a vector, go via memcpy()
+TSR_TARGET static void
+TSR_FN(tsr_copy_stream)(char * restrict dst, const char * restrict src, size_t num)
+{
+	size_t	head = (-(uintptr_t)dst) & (TSR_VSIZE - 1);
+
+	if (num < (head + TSR_VSIZE)) {
+		memcpy(dst, src, num);
+		return;
+	}
+
+	memcpy(dst, src, head);
+	dst += head, src += head, num -= head;
+
+	TSR_MOVES(num - (num % TSR_VSIZE), num - (num % TSR_VSIZE));
+
+	for ( ; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		TSR_VSTREAM(dst, TSR_VLOAD(src));
+		dst += TSR_VSIZE, src += TSR_VSIZE;
+	}
+
+	// Make the stores visible before anything that follows the copy
+	_mm_sfence();
+
+	memcpy(dst, src, num);
+} // tsr_copy_stream
+
+
+// The memmove() of rotate_small() on arrays larger than the LLC.  Everything
+// that the move lands on has already been read, or saved off, so it's written
+// with non-temporal stores rather than being dragged through the cache.  The
+// blocks overlap, so the move works away from the end that the data is moving
+// towards.  So long as the blocks are at least a vector apart, each vector is
+// then loaded before any store can land on it.  Closer moves use memmove()
+TSR_TARGET static void
+TSR_FN(tsr_move_stream)(char *dst, const char *src, size_t num)
+{
+	size_t	gap = (dst < src) ? src - dst : dst - src, edge;
+
+	if ((gap < TSR_VSIZE) || (num < (4 * TSR_VSIZE))) {
+		memmove(dst, src, num);
+		return;
+	}
+
+	if (dst < src) {
+		edge = (-(uintptr_t)dst) & (TSR_VSIZE - 1);
+		memmove(dst, src, edge);
+		dst += edge, src += edge, num -= edge;
+
+		TSR_MOVES(num - (num % TSR_VSIZE), num - (num % TSR_VSIZE));
+
+		for ( ; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+			TSR_VSTREAM(dst, TSR_VLOAD(src));
+			dst += TSR_VSIZE, src += TSR_VSIZE;
+		}
+		_mm_sfence();
+
+		memmove(dst, src, num);
+	} else {
+		edge = (uintptr_t)(dst + num) & (TSR_VSIZE - 1);
+		num -= edge;
+		memmove(dst + num, src + num, edge);
+
+		TSR_MOVES(num - (num % TSR_VSIZE), num - (num % TSR_VSIZE));
+
+		for ( ; num >= TSR_VSIZE; num -= TSR_VSIZE)
+			TSR_VSTREAM(dst + num - TSR_VSIZE, TSR_VLOAD(src + num - TSR_VSIZE));
+		_mm_sfence();
+
+		memmove(dst, src, num);
+	}
+} // tsr_move_stream
+
+
+// A rotation of up to TSR_TINY_VECS vectors' worth of bytes is done entirely in
+// registers.  Both blocks are loaded whole, and then stored back whole, each in
+// the place of the other, so that every byte is read once and written once,
+// with no stack buffer and no calls to memcpy() or memmove()
+#define TSR_TINY_VECS		8
+
+// A block of up to TSR_TINY_VECS vectors, held in registers.  Blocks smaller
+// than a vector are held in the low 128 bits of the first four vectors, or
+// in the Q registers if smaller still
+typedef struct {
+	TSR_VEC		v[TSR_TINY_VECS];
+	uint64_t	q[2];
+} TSR_FN(tsr_tiny_t);
+
+// The offset of the I'th of the SIZE byte registers that cover a NUM byte block.
+// The registers are laid end to end, with the last ones pulled back to line up
+// with the end of the block, so that no byte outside of it is ever touched
+#define TSR_TINY_AT(i, size, num)	(((i) * (size) < (num) - (size)) ? (i) * (size) : (num) - (size))
+
+
+// Loads NUM bytes at SRC into T.  Each size is loaded as a set of possibly
+// overlapping registers, the last of which is pulled back to line up with the
+// end of the block.  The switch upon the number of vectors is a jump table
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_tiny_load)(TSR_FN(tsr_tiny_t) *t, const char *src, size_t num)
+{
+	if (num >= TSR_VSIZE) {
+		switch ((num - 1) / TSR_VSIZE) {
+		case 7:	t->v[7] = TSR_VLOAD(src + 6 * TSR_VSIZE);	// Fall through
+		case 6:	t->v[6] = TSR_VLOAD(src + 5 * TSR_VSIZE);	// Fall through
+		case 5:	t->v[5] = TSR_VLOAD(src + 4 * TSR_VSIZE);	// Fall through
+		case 4:	t->v[4] = TSR_VLOAD(src + 3 * TSR_VSIZE);	// Fall through
+		case 3:	t->v[3] = TSR_VLOAD(src + 2 * TSR_VSIZE);	// Fall through
+		case 2:	t->v[2] = TSR_VLOAD(src + 1 * TSR_VSIZE);	// Fall through
+		case 1:	t->v[1] = TSR_VLOAD(src);			// Fall through
+		default: t->v[0] = TSR_VLOAD(src + num - TSR_VSIZE);
+		}
+	} else if (num >= 16) {
+		t->v[0] = TSR_VFROM128(_mm_loadu_si128((const __m128i *)(src + TSR_TINY_AT(0, 16, num))));
+		t->v[1] = TSR_VFROM128(_mm_loadu_si128((const __m128i *)(src + TSR_TINY_AT(1, 16, num))));
+		t->v[2] = TSR_VFROM128(_mm_loadu_si128((const __m128i *)(src + TSR_TINY_AT(2, 16, num))));
+		t->v[3] = TSR_VFROM128(_mm_loadu_si128((const __m128i *)(src + TSR_TINY_AT(3, 16, num))));
+	} else if (num >= 8) {
+		memcpy(&t->q[0], src, 8), memcpy(&t->q[1], src + num - 8, 8);
+	} else if (num >= 4) {
+		uint32_t	a, b;
+
+		memcpy(&a, src, 4), memcpy(&b, src + num - 4, 4);
+		t->q[0] = a, t->q[1] = b;
+	} else if (num >= 2) {
+		uint16_t	a, b;
+
+		memcpy(&a, src, 2), memcpy(&b, src + num - 2, 2);
+		t->q[0] = a, t->q[1] = b;
+	} else if (num) {
+		t->q[0] = *src;
+	}
+} // tsr_tiny_load
+
+
+// Stores the NUM bytes held in T to DST, in the same way that they were loaded
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_tiny_store)(const TSR_FN(tsr_tiny_t) *t, char *dst, size_t num)
+{
+	if (num >= TSR_VSIZE) {
+		switch ((num - 1) / TSR_VSIZE) {
+		case 7:	TSR_VSTORE(dst + 6 * TSR_VSIZE, t->v[7]);	// Fall through
+		case 6:	TSR_VSTORE(dst + 5 * TSR_VSIZE, t->v[6]);	// Fall through
+		case 5:	TSR_VSTORE(dst + 4 * TSR_VSIZE, t->v[5]);	// Fall through
+		case 4:	TSR_VSTORE(dst + 3 * TSR_VSIZE, t->v[4]);	// Fall through
+		case 3:	TSR_VSTORE(dst + 2 * TSR_VSIZE, t->v[3]);	// Fall through
+		case 2:	TSR_VSTORE(dst + 1 * TSR_VSIZE, t->v[2]);	// Fall through
+		case 1:	TSR_VSTORE(dst, t->v[1]);			// Fall through
+		default: TSR_VSTORE(dst + num - TSR_VSIZE, t->v[0]);
+		}
+	} else if (num >= 16) {
+		_mm_storeu_si128((__m128i *)(dst + TSR_TINY_AT(0, 16, num)), TSR_VTO128(t->v[0]));
+		_mm_storeu_si128((__m128i *)(dst + TSR_TINY_AT(1, 16, num)), TSR_VTO128(t->v[1]));
+		_mm_storeu_si128((__m128i *)(dst + TSR_TINY_AT(2, 16, num)), TSR_VTO128(t->v[2]));
+		_mm_storeu_si128((__m128i *)(dst + TSR_TINY_AT(3, 16, num)), TSR_VTO128(t->v[3]));
+	} else if (num >= 8) {
+		memcpy(dst, &t->q[0], 8), memcpy(dst + num - 8, &t->q[1], 8);
+	} else if (num >= 4) {
+		uint32_t	a = t->q[0], b = t->q[1];
+
+		memcpy(dst, &a, 4), memcpy(dst + num - 4, &b, 4);
+	} else if (num >= 2) {
+		uint16_t	a = t->q[0], b = t->q[1];
+
+		memcpy(dst, &a, 2), memcpy(dst + num - 2, &b, 2);
+	} else if (num) {
+		*dst = t->q[0];
+	}
+} // tsr_tiny_store
+
+
+// Only the registers of a tsr_tiny_t that were loaded are ever stored, but GCC
+// can't see that the load and store switches agree, and so warns that every
+// register may be used uninitialised.  Zeroing them to quieten it costs 1-2ns
+// on rotations of 10-50 items, which are just what they exist to speed up, so
+// the warning is turned off from here down to tsr_stage_small_at() instead
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Rotates the NA bytes at PA with the NB bytes that follow them, where NA + NB
+// is no more than TSR_TINY_VECS vectors' worth of bytes
+TSR_TARGET static void
+TSR_FN(tsr_rotate_tiny)(char *pa, size_t na, size_t nb)
+{
+	TSR_FN(tsr_tiny_t)	a, b;
+
+	TSR_MOVES(na + nb, na + nb);
+
+	TSR_FN(tsr_tiny_load)(&a, pa, na);
+	TSR_FN(tsr_tiny_load)(&b, pa + na, nb);
+
+	TSR_FN(tsr_tiny_store)(&b, pa, nb);
+	TSR_FN(tsr_tiny_store)(&a, pa + nb, na);
+} // tsr_rotate_tiny
+
+
+// Moves NUM bytes from SRC to DST, where DST is below SRC, a vector at a time
+// upwards.  Each store lands wholly below the next load, so any distance
+// between the blocks is fine, even of less than a vector.  The last vector is
+// loaded before anything is stored, and is stored last over the tail.  NUM
+// must be at least a vector
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_stage_down)(char *dst, const char *src, size_t num, size_t dist)
+{
+	TSR_VEC	tail = TSR_VLOAD(src + num - TSR_VSIZE);
+	char	*end = dst + num - TSR_VSIZE;
+
+	for ( ; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		if (dist)
+			TSR_PREFETCH(src + dist);
+
+		TSR_VSTORE(dst, TSR_VLOAD(src));
+		dst += TSR_VSIZE, src += TSR_VSIZE;
+	}
+	TSR_VSTORE(end, tail);
+} // tsr_stage_down
+
+
+// The same as tsr_stage_down(), but with DST above SRC, and so working down
+// from the ends of the blocks, with the first vector stored last
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_stage_up)(char *dst, const char *src, size_t num, size_t dist)
+{
+	TSR_VEC	head = TSR_VLOAD(src);
+	char	*start = dst;
+
+	for (dst += num, src += num; num >= TSR_VSIZE; num -= TSR_VSIZE) {
+		dst -= TSR_VSIZE, src -= TSR_VSIZE;
+
+		if (dist)
+			TSR_PREFETCH(src - dist);
+
+		TSR_VSTORE(dst, TSR_VLOAD(src));
+	}
+	TSR_VSTORE(start, head);
+} // tsr_stage_up
+
+
+// The stack free stand-in for rotate_small() that TSR_STACK_FREE builds use.
+// The smaller block is held in registers, rather than copied out to a stack
+// buffer, while the larger block is moved over by tsr_stage_down() or
+// tsr_stage_up().  Both are inlined, and call nothing, so that the held block
+// never has to be spilled to the stack.  The smaller block must be no more
+// than TSR_TINY_VECS vectors' worth of bytes
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_stage_small_at)(char *pa, char *pb, char *pe, size_t dist)
+{
+	size_t	na = pb - pa, nb = pe - pb;
+	TSR_FN(tsr_tiny_t)	t;
+
+	if ((na + nb) <= (TSR_TINY_VECS * TSR_VSIZE))
+		return TSR_FN(tsr_rotate_tiny)(pa, na, nb);
+
+	TSR_MOVES(na + nb, na + nb);
+
+	if (na < nb) {
+		TSR_FN(tsr_tiny_load)(&t, pa, na);
+		TSR_FN(tsr_stage_down)(pa, pb, nb, dist);
+		TSR_FN(tsr_tiny_store)(&t, pa + nb, na);
+	} else {
+		TSR_FN(tsr_tiny_load)(&t, pb, nb);
+		TSR_FN(tsr_stage_up)(pa + nb, pa, na, dist);
+		TSR_FN(tsr_tiny_store)(&t, pa, nb);
+	}
+} // tsr_stage_small_at
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+// The stack free stand-in for rotate_overlap().  The overlap cannot be held in
+// registers across a bridge, as the bridge kernels call out to finish off, and
+// the registers would be spilled to the stack around the call.  Instead, the
+// smaller block is swapped with the end of the larger block that it is bound
+// for.  That leaves the overlap, of up to TSR_TINY_VECS vectors' worth of
+// bytes, to be rotated with the smaller block by tsr_stage_small_at()
+TSR_TARGET static inline __attribute__((always_inline)) void
+TSR_FN(tsr_stage_overlap_at)(char *pa, char *pb, char *pe, size_t dist)
+{
+	size_t	na = pb - pa, nb = pe - pb;
+
+	if (na < nb) {
+		TSR_FN(tsr_two_way_swap_block_at)(pa, pb, na, dist);
+		TSR_FN(tsr_stage_small_at)(pb, pb + na, pe, dist);
+	} else {
+		TSR_FN(tsr_two_way_swap_block_at)(pa, pb, nb, dist);
+		TSR_FN(tsr_stage_small_at)(pa + nb, pb, pe, dist);
+	}
+} // tsr_stage_overlap_at
+
+
+TSR_TARGET static void
+TSR_FN(tsr_stage_small)(char *pa, char *pb, char *pe)
+{
+	TSR_FN(tsr_stage_small_at)(pa, pb, pe, 0);
+} // tsr_stage_small
+
+
+TSR_TARGET static void
+TSR_FN(tsr_stage_small_far)(char *pa, char *pb, char *pe)
+{
+	TSR_FN(tsr_stage_small_at)(pa, pb, pe, tsr_prefetch_distance);
+} // tsr_stage_small_far
+
+
+TSR_TARGET static void
+TSR_FN(tsr_stage_overlap)(char *pa, char *pb, char *pe)
+{
+	TSR_FN(tsr_stage_overlap_at)(pa, pb, pe, 0);
+} // tsr_stage_overlap
+
+
+TSR_TARGET static void
+TSR_FN(tsr_stage_overlap_far)(char *pa, char *pb, char *pe)
+{
+	TSR_FN(tsr_stage_overlap_at)(pa, pb, pe, tsr_prefetch_distance);
+} // tsr_stage_overlap_far
+
+
+static const tsr_simd_ops_t TSR_FN(tsr_simd_ops) = {
+	.two_way_swap_block = TSR_FN(tsr_two_way_swap_block),
+	.bridge_up          = TSR_FN(tsr_bridge_up),
+	.bridge_down        = TSR_FN(tsr_bridge_down),
+	.ring_positive      = TSR_FN(tsr_ring_positive),
+	.ring_negative      = TSR_FN(tsr_ring_negative),
+	.two_way_swap_block_far = TSR_FN(tsr_two_way_swap_block_far),
+	.bridge_up_far      = TSR_FN(tsr_bridge_up_far),
+	.bridge_down_far    = TSR_FN(tsr_bridge_down_far),
+	.ring_positive_far  = TSR_FN(tsr_ring_positive_far),
+	.ring_negative_far  = TSR_FN(tsr_ring_negative_far),
+	.copy_stream        = TSR_FN(tsr_copy_stream),
+	.move_stream        = TSR_FN(tsr_move_stream),
+	.rotate_tiny        = TSR_FN(tsr_rotate_tiny),
+	.tiny_max           = TSR_TINY_VECS * TSR_VSIZE,
+	.stage_small        = TSR_FN(tsr_stage_small),
+	.stage_overlap      = TSR_FN(tsr_stage_overlap),
+	.stage_small_far    = TSR_FN(tsr_stage_small_far),
+	.stage_overlap_far  = TSR_FN(tsr_stage_overlap_far),
+	.name               = TSR_ISA_NAME,
+};
+
+
+#undef TSR_TINY_VECS
+#undef TSR_TINY_AT
+#undef TSR_PREFETCH
+#undef TSR_VSIZE
+#undef TSR_FN
+#undef TSR_EXPAND
+#undef TSR_PASTE
+#undef TSR_ISA_NAME
+#undef TSR_SUFFIX
+#undef TSR_TARGET
+#undef TSR_VSTREAM
+#undef TSR_VFROM128
+#undef TSR_VTO128
+#undef TSR_VSTORE
+#undef TSR_VLOAD
+#undef TSR_VEC
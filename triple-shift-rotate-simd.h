@@ -0,0 +1,493 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                  Triple Shift Rotate V2 - Explicit SIMD Kernels
+//
+// This file is NOT meant to be included directly.  It is included by
+// triple-shift-rotate.h, and provides triple_shift_rotate_v2_simd().
+//
+// The plain V2 kernels rely upon the compiler auto-vectorising the ring loops,
+// which does not always happen, and what does happen differs by compiler.  The
+// kernels here are instead written directly with SSE2, AVX2 and AVX-512 vector
+// loads and stores.  All three are compiled into every binary via per-function
+// target attributes, and the best one that the CPU supports is selected once,
+// at program load time, via cpuid.  So a single binary will run with the best
+// kernels on every generation of x86-64 CPU.  On other architectures, the
+// portable scalar kernels below are used.
+//
+// Note that the ring, swap and bridge kernels only ever move items in lockstep
+// so they work just as well when counting in BYTES, as in items of any size.
+// Every kernel here therefore operates upon bytes, and the V2 driver is also
+// stamped out to count in bytes.  This lets the same kernels serve any item
+// width.
+
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+typedef struct {
+	void	(*two_way_swap_block)(char * restrict pa, char * restrict pb, size_t num);
+	void	(*bridge_up)(char * restrict pa, char *pb, char *pc, size_t num);
+	void	(*bridge_down)(char * restrict pc, char *pd, char *pe, size_t num);
+	void	(*ring_positive)(char * restrict pa, char * restrict po, char * restrict pb, size_t num);
+	void	(*ring_negative)(char * restrict pa, char * restrict po, char * restrict pb, size_t num);
+
+	// The same again, but prefetching for arrays that are larger than the LLC
+	void	(*two_way_swap_block_far)(char * restrict pa, char * restrict pb, size_t num);
+	void	(*bridge_up_far)(char * restrict pa, char *pb, char *pc, size_t num);
+	void	(*bridge_down_far)(char * restrict pc, char *pd, char *pe, size_t num);
+	void	(*ring_positive_far)(char * restrict pa, char * restrict po, char * restrict pb, size_t num);
+	void	(*ring_negative_far)(char * restrict pa, char * restrict po, char * restrict pb, size_t num);
+
+	// Copies and moves with stores that go around the caches
+	void	(*copy_stream)(char * restrict dst, const char * restrict src, size_t num);
+	void	(*move_stream)(char *dst, const char *src, size_t num);
+
+	// Rotates up to TINY_MAX bytes in all, entirely within registers
+	void	(*rotate_tiny)(char *pa, size_t na, size_t nb);
+	size_t	tiny_max;
+
+	// Stand-ins for rotate_small() and rotate_overlap() that hold the smaller
+	// block or the overlap, of up to TINY_MAX bytes, in registers rather than
+	// in a stack buffer.  Used by TSR_STACK_FREE builds
+	void	(*stage_small)(char *pa, char *pb, char *pe);
+	void	(*stage_overlap)(char *pa, char *pb, char *pe);
+	void	(*stage_small_far)(char *pa, char *pb, char *pe);
+	void	(*stage_overlap_far)(char *pa, char *pb, char *pe);
+	char	*name;
+} tsr_simd_ops_t;
+
+
+//------------------------------------------------------------------------------
+//                     Portable Scalar Byte-wise Kernels
+//------------------------------------------------------------------------------
+
+// These move 8 bytes at a time via memcpy(), which is safe for any alignment
+// and compiles to a plain load or store, and then finish off byte by byte.
+// They serve both as the kernels on non-x86 CPUs, and to finish off the last
+// partial vector's worth of bytes for the SIMD kernels.
+
+static void
+tsr_scalar_two_way_swap_block(char * restrict pa, char * restrict pb, size_t num)
+{
+	uint64_t a, b;
+	char	t;
+
+	TSR_MOVES(2 * num, 2 * num);
+
+	for ( ; num >= sizeof(a); num -= sizeof(a)) {
+		memcpy(&a, pa, sizeof(a)), memcpy(&b, pb, sizeof(b));
+		memcpy(pa, &b, sizeof(b)), memcpy(pb, &a, sizeof(a));
+		pa += sizeof(a), pb += sizeof(a);
+	}
+
+	while (num--)
+		t = *pa, *pa++ = *pb, *pb++ = t;
+} // tsr_scalar_two_way_swap_block
+
+
+static void
+tsr_scalar_bridge_up(char * restrict pa, char *pb, char *pc, size_t num)
+{
+	uint64_t a, b;
+
+	TSR_MOVES(2 * num, 2 * num);
+
+	for ( ; num >= sizeof(a); num -= sizeof(a)) {
+		memcpy(&a, pa, sizeof(a)), memcpy(&b, pb, sizeof(b));
+		memcpy(pc, &a, sizeof(a)), memcpy(pa, &b, sizeof(b));
+		pa += sizeof(a), pb += sizeof(a), pc += sizeof(a);
+	}
+
+	while (num--)
+		*pc++ = *pa, *pa++ = *pb++;
+} // tsr_scalar_bridge_up
+
+
+static void
+tsr_scalar_bridge_down(char * restrict pc, char *pd, char *pe, size_t num)
+{
+	uint64_t c, d;
+
+	TSR_MOVES(2 * num, 2 * num);
+
+	for ( ; num >= sizeof(c); num -= sizeof(c)) {
+		pc -= sizeof(c), pd -= sizeof(c), pe -= sizeof(c);
+		memcpy(&c, pc, sizeof(c)), memcpy(&d, pd, sizeof(d));
+		memcpy(pe, &c, sizeof(c)), memcpy(pc, &d, sizeof(d));
+	}
+
+	while (num--)
+		*--pe = *--pc, *pc = *--pd;
+} // tsr_scalar_bridge_down
+
+
+static void
+tsr_scalar_ring_positive(char * restrict pa, char * restrict po, char * restrict pb, size_t num)
+{
+	uint64_t a, o, b;
+	char	t;
+
+	TSR_MOVES(3 * num, 3 * num);
+
+	for ( ; num >= sizeof(a); num -= sizeof(a)) {
+		memcpy(&a, pa, sizeof(a)), memcpy(&o, po, sizeof(o)), memcpy(&b, pb, sizeof(b));
+		memcpy(pa, &o, sizeof(o)), memcpy(po, &b, sizeof(b)), memcpy(pb, &a, sizeof(a));
+		pa += sizeof(a), po += sizeof(a), pb += sizeof(a);
+	}
+
+	while (num--)
+		t = *pa, *pa++ = *po, *po++ = *pb, *pb++ = t;
+} // tsr_scalar_ring_positive
+
+
+static void
+tsr_scalar_ring_negative(char * restrict pa, char * restrict po, char * restrict pb, size_t num)
+{
+	uint64_t a, o, b;
+	char	t;
+
+	TSR_MOVES(3 * num, 3 * num);
+
+	for ( ; num >= sizeof(a); num -= sizeof(a)) {
+		pa -= sizeof(a), po -= sizeof(a), pb -= sizeof(a);
+		memcpy(&a, pa, sizeof(a)), memcpy(&o, po, sizeof(o)), memcpy(&b, pb, sizeof(b));
+		memcpy(pb, &o, sizeof(o)), memcpy(po, &a, sizeof(a)), memcpy(pa, &b, sizeof(b));
+	}
+
+	while (num--)
+		t = *--pb, *pb = *--po, *po = *--pa, *pa = t;
+} // tsr_scalar_ring_negative
+
+
+// There are no portable non-temporal stores, so these are just a plain copy
+// and move
+static void
+tsr_scalar_copy_stream(char * restrict dst, const char * restrict src, size_t num)
+{
+	memcpy(dst, src, num);
+} // tsr_scalar_copy_stream
+
+
+static void
+tsr_scalar_move_stream(char *dst, const char *src, size_t num)
+{
+	memmove(dst, src, num);
+} // tsr_scalar_move_stream
+
+
+// There are no registers to rotate within, so the tiny_max of 0 that the
+// scalar table has keeps V2 from ever calling this.  It is still a complete
+// rotation though, by swapping the smaller block into place until none is left
+static void
+tsr_scalar_rotate_tiny(char *pa, size_t na, size_t nb)
+{
+	while (na && nb) {
+		if (na <= nb) {
+			tsr_scalar_two_way_swap_block(pa, pa + na, na);
+			pa += na, nb -= na;
+		} else {
+			tsr_scalar_two_way_swap_block(pa + na - nb, pa + na, nb);
+			na -= nb;
+		}
+	}
+} // tsr_scalar_rotate_tiny
+
+
+static const tsr_simd_ops_t tsr_simd_ops_scalar = {
+	.two_way_swap_block = tsr_scalar_two_way_swap_block,
+	.bridge_up          = tsr_scalar_bridge_up,
+	.bridge_down        = tsr_scalar_bridge_down,
+	.ring_positive      = tsr_scalar_ring_positive,
+	.ring_negative      = tsr_scalar_ring_negative,
+	.two_way_swap_block_far = tsr_scalar_two_way_swap_block,
+	.bridge_up_far      = tsr_scalar_bridge_up,
+	.bridge_down_far    = tsr_scalar_bridge_down,
+	.ring_positive_far  = tsr_scalar_ring_positive,
+	.ring_negative_far  = tsr_scalar_ring_negative,
+	.copy_stream        = tsr_scalar_copy_stream,
+	.move_stream        = tsr_scalar_move_stream,
+	.rotate_tiny        = tsr_scalar_rotate_tiny,
+	.tiny_max           = 0,		// So neither it nor the stage kernels are called
+	.name               = "scalar",
+};
+
+
+//------------------------------------------------------------------------------
+//                        x86 SSE2 / AVX2 / AVX-512 Kernels
+//------------------------------------------------------------------------------
+
+// How far ahead, in bytes, that the _far kernels prefetch each of the blocks
+// that they are walking through.  The best distance depends upon the memory
+// latency of the machine, and `./rotate large` measures a range of them
+#ifndef TSR_PREFETCH_DISTANCE
+#define TSR_PREFETCH_DISTANCE	1024
+#endif
+
+static size_t	tsr_prefetch_distance = TSR_PREFETCH_DISTANCE;
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define TSR_VEC			__m128i
+#define TSR_VLOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+#define TSR_VSTORE(p, v)	_mm_storeu_si128((__m128i *)(p), (v))
+#define TSR_VSTREAM(p, v)	_mm_stream_si128((__m128i *)(p), (v))
+#define TSR_VFROM128(x)		(x)
+#define TSR_VTO128(v)		(v)
+#define TSR_TARGET		__attribute__((target("sse2")))
+#define TSR_SUFFIX		_sse2
+#define TSR_ISA_NAME		"sse2"
+#include "triple-shift-rotate-simd-template.h"
+
+#define TSR_VEC			__m256i
+#define TSR_VLOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define TSR_VSTORE(p, v)	_mm256_storeu_si256((__m256i *)(p), (v))
+#define TSR_VSTREAM(p, v)	_mm256_stream_si256((__m256i *)(p), (v))
+#define TSR_VFROM128(x)		_mm256_castsi128_si256(x)
+#define TSR_VTO128(v)		_mm256_castsi256_si128(v)
+#define TSR_TARGET		__attribute__((target("avx2")))
+#define TSR_SUFFIX		_avx2
+#define TSR_ISA_NAME		"avx2"
+#include "triple-shift-rotate-simd-template.h"
+
+#define TSR_VEC			__m512i
+#define TSR_VLOAD(p)		_mm512_loadu_si512((const void *)(p))
+#define TSR_VSTORE(p, v)	_mm512_storeu_si512((void *)(p), (v))
+#define TSR_VSTREAM(p, v)	_mm512_stream_si512((void *)(p), (v))
+#define TSR_VFROM128(x)		_mm512_castsi128_si512(x)
+#define TSR_VTO128(v)		_mm512_castsi512_si128(v)
+#define TSR_TARGET		__attribute__((target("avx512f")))
+#define TSR_SUFFIX		_avx512
+#define TSR_ISA_NAME		"avx512"
+#include "triple-shift-rotate-simd-template.h"
+
+#endif
+
+
+//------------------------------------------------------------------------------
+//                          Load Time CPU Dispatch
+//------------------------------------------------------------------------------
+
+// The kernels in use by triple_shift_rotate_v2_simd()
+static const tsr_simd_ops_t *tsr_simd = &tsr_simd_ops_scalar;
+
+// Every kernel table that is compiled in, best first
+static const tsr_simd_ops_t *tsr_simd_all[] = {
+#if defined(__x86_64__) || defined(__i386__)
+	&tsr_simd_ops_avx512,
+	&tsr_simd_ops_avx2,
+	&tsr_simd_ops_sse2,
+#endif
+	&tsr_simd_ops_scalar,
+	NULL
+};
+
+
+// Returns true if the CPU that we're running on can execute the OPS kernels
+static bool
+tsr_simd_supported(const tsr_simd_ops_t *ops)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+
+	if (ops == &tsr_simd_ops_avx512)
+		return __builtin_cpu_supports("avx512f");
+	if (ops == &tsr_simd_ops_avx2)
+		return __builtin_cpu_supports("avx2");
+	if (ops == &tsr_simd_ops_sse2)
+		return __builtin_cpu_supports("sse2");
+#endif
+	return (ops == &tsr_simd_ops_scalar);
+} // tsr_simd_supported
+
+
+// Selects the kernel table with the given NAME, such as to force a particular
+// instruction set for testing.  Returns false, and leaves the current kernels
+// in place, if no such kernels exist or if the CPU can't run them
+static bool
+tsr_simd_select(const char *name)
+{
+	for (const tsr_simd_ops_t **ops = tsr_simd_all; *ops; ops++) {
+		if (strcmp((*ops)->name, name) == 0) {
+			if (!tsr_simd_supported(*ops))
+				return false;
+			tsr_simd = *ops;
+			return true;
+		}
+	}
+	return false;
+} // tsr_simd_select
+
+
+// Runs at program load time to pick the best kernels that this CPU supports
+__attribute__((constructor)) static void
+tsr_simd_init(void)
+{
+	for (const tsr_simd_ops_t **ops = tsr_simd_all; *ops; ops++) {
+		if (tsr_simd_supported(*ops)) {
+			tsr_simd = *ops;
+			return;
+		}
+	}
+} // tsr_simd_init
+
+
+//------------------------------------------------------------------------------
+//                        Arrays Larger Than The Cache
+//------------------------------------------------------------------------------
+
+// Once an array is larger than the last level cache, a rotation of it is bound
+// by memory bandwidth, and not by the kernels.  The ring passes then stream
+// through three far apart blocks at once, which can be more streams than the
+// hardware prefetchers keep track of, and the memmove() of rotate_small() drags
+// everything that it writes through the cache, for no later gain.  So at and
+// above tsr_nt_threshold bytes, a second V2 driver is used, which calls the
+// _far kernels that prefetch each of their blocks tsr_prefetch_distance bytes
+// ahead, and which moves with non-temporal stores.  The threshold is the size
+// of the last level cache, as found at load time, or TSR_NT_THRESHOLD if that
+// is defined.
+
+#ifndef TSR_NT_FALLBACK
+#define TSR_NT_FALLBACK		(8 * 1024 * 1024)
+#endif
+
+// Arrays and destinations of at least this many bytes are treated as uncacheable
+static size_t	tsr_nt_threshold = TSR_NT_FALLBACK;
+
+
+// Sets tsr_nt_threshold to the size of the last level cache
+__attribute__((constructor)) static void
+tsr_nt_init(void)
+{
+#if defined(TSR_NT_THRESHOLD)
+	tsr_nt_threshold = TSR_NT_THRESHOLD;
+#elif defined(_SC_LEVEL3_CACHE_SIZE)
+	long	llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+	if (llc <= 0)
+		llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (llc > 0)
+		tsr_nt_threshold = llc;
+#endif
+} // tsr_nt_init
+
+
+//------------------------------------------------------------------------------
+//                           SIMD Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Stamp out a V2 driver that counts in bytes, and which calls through to the
+// selected kernels.  This produces triple_shift_rotate_v2_bytes()
+#define TSR_ITEM		char
+#define TSR_SUFFIX		_bytes
+#define TSR_KERNEL(name)	tsr_simd->name
+#ifdef TSR_STACK_FREE
+#define TSR_STAGE_SIZE		tsr_simd->tiny_max
+#endif
+#include "triple-shift-rotate-template.h"
+
+// And the same for arrays larger than the LLC.  This produces
+// triple_shift_rotate_v2_bytes_far()
+#define TSR_ITEM		char
+#define TSR_SUFFIX		_bytes_far
+#define TSR_KERNEL(name)	tsr_simd->name##_far
+#define TSR_MEMMOVE(d, s, n)	tsr_simd->move_stream((char *)(d), (const char *)(s), (n))
+#ifdef TSR_STACK_FREE
+#define TSR_STAGE_SIZE		tsr_simd->tiny_max
+#endif
+#include "triple-shift-rotate-template.h"
+
+// Rotates NA items of SIZE bytes each at BASE with the NB items that follow,
+// using the explicit SIMD kernels.  Rotations small enough to fit within the
+// registers of the instruction set skip the V2 driver altogether
+static void
+triple_shift_rotate_v2_simd_sized(void *base, size_t na, size_t nb, size_t size)
+{
+	size_t	num = (na + nb) * size;
+
+	if (num <= tsr_simd->tiny_max)
+		return tsr_simd->rotate_tiny(base, na * size, nb * size);
+
+	if (num >= tsr_nt_threshold)
+		return triple_shift_rotate_v2_bytes_far(base, na * size, nb * size);
+
+	triple_shift_rotate_v2_bytes(base, na * size, nb * size);
+} // triple_shift_rotate_v2_simd_sized
+
+
+static void
+triple_shift_rotate_v2_simd(uintptr_t *pa, size_t na, size_t nb)
+{
+	triple_shift_rotate_v2_simd_sized(pa, na, nb, sizeof(*pa));
+} // triple_shift_rotate_v2_simd
+
+
+//------------------------------------------------------------------------------
+//                           Out-Of-Place Rotate Copy
+//------------------------------------------------------------------------------
+
+// rotate_copy() writes a rotated copy of one array into another.  That is the
+// same as a memcpy() followed by an in-place rotation, but with the rotation
+// folded into the copy, as two straight copies of the two blocks.  The source
+// is read once, and the destination written once, which is the least that any
+// rotation can possibly do.
+//
+// Once the destination is larger than the last level cache, it cannot stay in
+// the cache anyway, and writing it through the cache would just evict the
+// caller's working set to make room for it.  So from tsr_nt_threshold bytes
+// up, the copies are done with non-temporal stores that go around the caches.
+
+
+// Writes the NB bytes after the first NA bytes at SRC, followed by those NA
+// bytes, to DST.  The two must not overlap
+static void
+rotate_copy_bytes(char * restrict dst, const char * restrict src, size_t na, size_t nb)
+{
+	if ((na + nb) >= tsr_nt_threshold) {
+		tsr_simd->copy_stream(dst, src + na, nb);
+		tsr_simd->copy_stream(dst + nb, src, na);
+	} else {
+		memcpy(dst, src + na, nb);
+		memcpy(dst + nb, src, na);
+	}
+} // rotate_copy_bytes
+
+
+// Copies the NA + NB items of SIZE bytes each at SRC to DST, rotated such that
+// the NB items come first.  SRC is left as it was
+static void
+rotate_copy_sized(void * restrict dst, const void * restrict src, size_t na, size_t nb, size_t size)
+{
+	rotate_copy_bytes(dst, src, na * size, nb * size);
+} // rotate_copy_sized
+
+
+static void
+rotate_copy(uintptr_t * restrict dst, const uintptr_t * restrict src, size_t na, size_t nb)
+{
+	rotate_copy_bytes((char *)dst, (const char *)src, na * sizeof(*src), nb * sizeof(*src));
+} // rotate_copy
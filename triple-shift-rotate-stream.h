@@ -0,0 +1,328 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                Triple Shift Rotate V2 - Out-Of-Core Streaming
+//
+// This file is NOT meant to be included directly.  It is included by
+// triple-shift-rotate.h, and provides triple_shift_rotate_stream().
+//
+// triple_shift_rotate_file() needs the whole range mapped at once, which rules
+// it out for files larger than the address space, and on systems where mmap()
+// of the file isn't possible.  Here the rotation is instead done through a
+// buffer of a fixed size, supplied by the caller, with pread() and pwrite().
+//
+// The V2 driver carries over as is, with the file offsets taking the place of
+// the pointers.  Each ring pass moves A to B, B to O, and O to A (or the other
+// way around), element by element, so any slice of the three blocks can be
+// done apart from the rest.  A ring pass is therefore done as chunks of up to
+// a third of the buffer.  Each chunk is read from the A, O and B blocks, and
+// then written straight back out to the block that it moves to, with nothing
+// ever being copied in memory.  Every chunk is a long sequential run, and the
+// chunks of each block are visited in order, so the file is read and written
+// as three sequential streams.
+//
+// Whenever the smaller block, or the overlap between the blocks, fits in half
+// of the buffer, the rotation is finished in the manner of rotate_small() and
+// rotate_overlap().  That piece is held in the buffer while the rest streams
+// through the other half, in a single pass that reads and writes every byte
+// just once.  The larger the buffer, the sooner that happens.
+//
+// The bytes read and written are added to the caller's tsr_stream_stats_t, so
+// that the I/O done can be compared against the least possible, being one
+// read and one write of every byte of the range.
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <unistd.h>
+
+// The largest offset that off_t can hold, which no standard header provides
+#define TSR_OFF_MAX	((off_t)(((uintmax_t)1 << ((sizeof(off_t) * 8) - 1)) - 1))
+
+// The I/O done by triple_shift_rotate_stream(), which adds to what is there
+typedef struct {
+	uint64_t	read;		// Bytes read from the file
+	uint64_t	written;	// Bytes written to the file
+} tsr_stream_stats_t;
+
+
+// Reads N bytes at OFF of FD into BUF, or writes them from BUF if WR is set,
+// carrying on after any short transfer.  Returns 0, or -1 with errno set
+static int
+tsr_stream_io(int fd, char *buf, size_t n, off_t off, bool wr, tsr_stream_stats_t *st)
+{
+	while (n > 0) {
+		ssize_t	got = wr ? pwrite(fd, buf, n, off) : pread(fd, buf, n, off);
+
+		if (got < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		// The range runs past the end of the file
+		if (got == 0) {
+			errno = EIO;
+			return -1;
+		}
+
+		if (wr)
+			st->written += got;
+		else
+			st->read += got;
+
+		buf += got, off += got, n -= got;
+	}
+	return 0;
+} // tsr_stream_io
+
+
+// See ring_positive() and ring_negative() in triple-shift-rotate.h.  PA, PO and
+// PB are the offsets of the START of each of the NUM byte blocks here, even for
+// a negative ring
+static int
+tsr_stream_ring(int fd, off_t pa, off_t po, off_t pb, off_t num, bool neg,
+		char *buf, size_t bufsize, tsr_stream_stats_t *st)
+{
+	size_t	chunk = bufsize / 3, n;
+	char	*ba = buf, *bo = ba + chunk, *bb = bo + chunk;
+
+	for (off_t k = 0; k < num; k += n) {
+		n = (size_t)(((num - k) < (off_t)chunk) ? num - k : (off_t)chunk);
+
+		if (tsr_stream_io(fd, ba, n, pa + k, false, st) ||
+		    tsr_stream_io(fd, bo, n, po + k, false, st) ||
+		    tsr_stream_io(fd, bb, n, pb + k, false, st))
+			return -1;
+
+		if (neg) {
+			if (tsr_stream_io(fd, bb, n, pa + k, true, st) ||
+			    tsr_stream_io(fd, ba, n, po + k, true, st) ||
+			    tsr_stream_io(fd, bo, n, pb + k, true, st))
+				return -1;
+		} else {
+			if (tsr_stream_io(fd, bo, n, pa + k, true, st) ||
+			    tsr_stream_io(fd, bb, n, po + k, true, st) ||
+			    tsr_stream_io(fd, ba, n, pb + k, true, st))
+				return -1;
+		}
+	}
+	return 0;
+} // tsr_stream_ring
+
+
+// Swaps the NUM bytes at PA with the NUM bytes at PB, in chunks of up to half
+// of the buffer
+static int
+tsr_stream_swap(int fd, off_t pa, off_t pb, off_t num, char *buf, size_t bufsize, tsr_stream_stats_t *st)
+{
+	size_t	chunk = bufsize / 2, n;
+	char	*ba = buf, *bb = ba + chunk;
+
+	for (off_t k = 0; k < num; k += n) {
+		n = (size_t)(((num - k) < (off_t)chunk) ? num - k : (off_t)chunk);
+
+		if (tsr_stream_io(fd, ba, n, pa + k, false, st) ||
+		    tsr_stream_io(fd, bb, n, pb + k, false, st) ||
+		    tsr_stream_io(fd, bb, n, pa + k, true, st) ||
+		    tsr_stream_io(fd, ba, n, pb + k, true, st))
+			return -1;
+	}
+	return 0;
+} // tsr_stream_swap
+
+
+// Finishes the rotation of the NA bytes at PA with the NB bytes that follow in
+// a single pass.  Either the smaller block (as per rotate_small()), or the
+// overlap between the blocks (as per rotate_overlap()), is held in the buffer
+// and written back last, while the pairs of chunks that remain are moved
+// through the rest of the buffer.  The chunks are visited in the order that
+// never overwrites a byte that has yet to be read
+static int
+tsr_stream_hold(int fd, off_t pa, off_t na, off_t nb, char *buf, size_t bufsize, tsr_stream_stats_t *st)
+{
+	off_t	ns = (na < nb) ? na : nb, nc = (na < nb) ? nb - na : na - nb;
+	off_t	hold = (ns < nc) ? ns : nc, pairs = (ns < nc) ? 0 : ns;
+	size_t	chunk = (bufsize - hold) / 2, n;
+	char	*bh = buf, *bx = bh + hold, *by = bx + chunk;
+
+	if (ns < nc) {
+		// Hold the smaller block, and slide the larger one over it
+		if (na < nb) {
+			if (tsr_stream_io(fd, bh, na, pa, false, st))
+				return -1;
+			for (off_t k = 0; k < nb; k += n) {
+				n = (size_t)(((nb - k) < (off_t)(2 * chunk)) ? nb - k : (off_t)(2 * chunk));
+				if (tsr_stream_io(fd, bx, n, pa + na + k, false, st) ||
+				    tsr_stream_io(fd, bx, n, pa + k, true, st))
+					return -1;
+			}
+			return tsr_stream_io(fd, bh, na, pa + nb, true, st);
+		}
+
+		if (tsr_stream_io(fd, bh, nb, pa + na, false, st))
+			return -1;
+		for (off_t k = na; k > 0; k -= n) {
+			n = (size_t)((k < (off_t)(2 * chunk)) ? k : (off_t)(2 * chunk));
+			if (tsr_stream_io(fd, bx, n, pa + k - n, false, st) ||
+			    tsr_stream_io(fd, bx, n, pa + k - n + nb, true, st))
+				return -1;
+		}
+		return tsr_stream_io(fd, bh, nb, pa, true, st);
+	}
+
+	// Hold the overlap, and move the equal sized blocks either side of it
+	if (na < nb) {
+		// A B1 B2 becomes B1 B2 A, with B2 held, working downwards
+		if (tsr_stream_io(fd, bh, nc, pa + na + na, false, st))
+			return -1;
+		for (off_t k = pairs; k > 0; k -= n) {
+			n = (size_t)((k < (off_t)chunk) ? k : (off_t)chunk);
+			if (tsr_stream_io(fd, bx, n, pa + k - n, false, st) ||
+			    tsr_stream_io(fd, by, n, pa + na + k - n, false, st) ||
+			    tsr_stream_io(fd, by, n, pa + k - n, true, st) ||
+			    tsr_stream_io(fd, bx, n, pa + nb + k - n, true, st))
+				return -1;
+		}
+		return tsr_stream_io(fd, bh, nc, pa + na, true, st);
+	}
+
+	// A1 A2 B becomes B A1 A2, with A2 held, working upwards
+	if (tsr_stream_io(fd, bh, nc, pa + nb, false, st))
+		return -1;
+	for (off_t k = 0; k < pairs; k += n) {
+		n = (size_t)(((pairs - k) < (off_t)chunk) ? pairs - k : (off_t)chunk);
+		if (tsr_stream_io(fd, bx, n, pa + k, false, st) ||
+		    tsr_stream_io(fd, by, n, pa + na + k, false, st) ||
+		    tsr_stream_io(fd, by, n, pa + k, true, st) ||
+		    tsr_stream_io(fd, bx, n, pa + nb + k, true, st))
+			return -1;
+	}
+	return tsr_stream_io(fd, bh, nc, pa + nb + nb, true, st);
+} // tsr_stream_hold
+
+
+// The V2 driver, upon the NA bytes at offset PA of FD and the NB bytes that
+// follow them.  Returns 0, or -1 with errno set
+static int
+tsr_stream_v2(int fd, off_t pa, off_t na, off_t nb, char *buf, size_t bufsize, tsr_stream_stats_t *st)
+{
+	off_t	half = bufsize / 2;
+
+	for (off_t pb = pa + na, pe = pb + nb; na; nb = pe - pb, na = pb - pa) {
+		if (na < nb) {
+			off_t	no = nb - na;
+
+			if ((na <= half) || (no <= half))
+				return tsr_stream_hold(fd, pa, na, nb, buf, bufsize, st);
+
+			for ( ; na > no; pa += no, na -= no)
+				if (tsr_stream_ring(fd, pa, pb, pe - na, no, false, buf, bufsize, st))
+					return -1;
+
+			if (tsr_stream_ring(fd, pa, pb, pe - na, na, false, buf, bufsize, st))
+				return -1;
+
+			pa = pb,  pe = pb + no,  pb += na;
+		} else if (na == nb) {
+			return tsr_stream_swap(fd, pa, pb, na, buf, bufsize, st);
+		} else if (nb == 0) {
+			return 0;
+		} else {
+			off_t	no = na - nb;
+
+			if ((nb <= half) || (no <= half))
+				return tsr_stream_hold(fd, pa, na, nb, buf, bufsize, st);
+
+			for ( ; nb > no; pe -= no, nb -= no)
+				if (tsr_stream_ring(fd, pa + nb - no, pb - no, pe - no, no, true, buf, bufsize, st))
+					return -1;
+
+			if (tsr_stream_ring(fd, pa, pb - nb, pe - nb, nb, true, buf, bufsize, st))
+				return -1;
+
+			pe = pb,  pa = pb - no,  pb -= nb;
+		}
+	}
+	return 0;
+} // tsr_stream_v2
+
+
+// Rotates the LEFT records of SIZE bytes each at byte OFFSET of the file open
+// for reading and writing as FD, with the RIGHT records that follow them, in
+// place within the file.  All I/O goes through the BUFSIZE bytes of BUF, which
+// must be at least 6 bytes, though the larger it is the better.  The bytes
+// read and written are added to STATS, if it is not NULL.  Returns 0 on
+// success, or -1 with errno set.  A range too large to count, or that runs
+// past the end of a regular file, is EINVAL, and the file is left untouched.
+// Any other failure leaves the range part way through the rotation
+static int
+triple_shift_rotate_stream(int fd, off_t offset, size_t left, size_t right, size_t size,
+			   void *buf, size_t bufsize, tsr_stream_stats_t *stats)
+{
+	tsr_stream_stats_t st = {0, 0};
+	size_t	na, nb;
+	struct	stat sb;
+	int	ret;
+
+	if ((offset < 0) || (buf == NULL) || (bufsize < 6)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// As for triple_shift_rotate_file(), any of these overflowing would wrap
+	// around to the wrong range, and here the end must also fit in an off_t
+	if ((size != 0) && ((left > (SIZE_MAX / size)) || (right > (SIZE_MAX / size)))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	na = left * size, nb = right * size;
+	if ((na > (SIZE_MAX - nb)) || ((uintmax_t)(na + nb) > (uintmax_t)(TSR_OFF_MAX - offset))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if ((na == 0) || (nb == 0))
+		return 0;
+
+	// Only a regular file has a size to check against.  Catching a range that
+	// runs past its end here keeps the passes from rewriting part of it first
+	if (fstat(fd, &sb) != 0)
+		return -1;
+
+	if (S_ISREG(sb.st_mode) && ((offset > sb.st_size) ||
+	    ((uintmax_t)(na + nb) > (uintmax_t)(sb.st_size - offset)))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ret = tsr_stream_v2(fd, offset, (off_t)na, (off_t)nb, buf, bufsize, &st);
+
+	if (stats)
+		stats->read += st.read, stats->written += st.written;
+
+	return ret;
+} // triple_shift_rotate_stream
@@ -0,0 +1,243 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                  Triple Shift Rotate V2 - Item Type Template
+//
+// This file is NOT meant to be included directly.  It is included once per
+// item width by triple-shift-rotate.h to stamp out a copy of the V2 kernels
+// and driver that moves items of that width.  Before including, define:
+//
+//   TSR_ITEM    - The item type that the kernels will move (eg. uint32_t)
+//   TSR_SUFFIX  - The suffix appended to every generated name (eg. _u32)
+//
+// So with TSR_SUFFIX set to _u32, triple_shift_rotate_v2_u32() is generated,
+// along with ring_positive_u32(), rotate_small_u32() and so on.
+//
+// Optionally, TSR_KERNEL(name) may also be defined to supply the kernels from
+// elsewhere, in which case only rotate_small(), rotate_overlap() and the V2
+// driver are generated, and every call to ring_positive, ring_negative,
+// two_way_swap_block, bridge_up and bridge_down goes via TSR_KERNEL(name).
+// The supplied kernels must take the same arguments as those below.
+// TSR_MEMMOVE(d, s, n) may likewise be defined to replace the memmove() of
+// rotate_small(), which otherwise is just memmove().
+//
+// If TSR_STAGE_SIZE is also defined, then rotate_small() and rotate_overlap()
+// are not generated at all, along with their stack buffers.  Instead they are
+// supplied as TSR_KERNEL(stage_small) and TSR_KERNEL(stage_overlap), which are
+// used for a smaller block, or overlap, of up to TSR_STAGE_SIZE bytes, rather
+// than MIN_STREAM_SIZE bytes.
+//
+// All of the above macros are #undef'd again at the end of this file.
+//
+// The code below mirrors the uintptr_t implementation in triple-shift-rotate.h
+// exactly, so refer to the comments there for how the algorithm operates.
+
+#if !defined(TSR_ITEM) || !defined(TSR_SUFFIX)
+#error "TSR_ITEM and TSR_SUFFIX must be defined before including this file"
+#endif
+
+#define TSR_PASTE(name, suffix)  name##suffix
+#define TSR_EXPAND(name, suffix) TSR_PASTE(name, suffix)
+#define TSR_FN(name)             TSR_EXPAND(name, TSR_SUFFIX)
+
+#ifndef TSR_KERNEL
+#define TSR_KERNEL(name)         TSR_FN(name)
+
+static inline void
+TSR_FN(two_way_swap_block)(TSR_ITEM * restrict pa, TSR_ITEM * restrict pb, size_t num)
+{
+	TSR_ITEM *stop = pb + num, t;
+
+	TSR_MOVES(2 * num * sizeof(*pa), 2 * num * sizeof(*pa));
+
+	while (pb != stop)
+		t = *pa, *pa++ = *pb, *pb++ = t;
+} // two_way_swap_block
+
+
+static inline void
+TSR_FN(bridge_down)(TSR_ITEM * restrict pc, TSR_ITEM *pd, TSR_ITEM *pe, size_t num)
+{
+	TSR_ITEM *stop = pc - num;
+
+	TSR_MOVES(2 * num * sizeof(*pc), 2 * num * sizeof(*pc));
+
+	while (pc != stop)
+		*--pe = *--pc, *pc = *--pd;
+} // bridge_down
+
+
+static inline void
+TSR_FN(bridge_up)(TSR_ITEM * restrict pa, TSR_ITEM *pb, TSR_ITEM *pc, size_t num)
+{
+	TSR_ITEM *stop = pc + num;
+
+	TSR_MOVES(2 * num * sizeof(*pc), 2 * num * sizeof(*pc));
+
+	while (pc != stop)
+		*pc++ = *pa, *pa++ = *pb++;
+} // bridge_up
+
+
+static inline void
+TSR_FN(ring_positive)(TSR_ITEM * restrict pa, TSR_ITEM * restrict po, TSR_ITEM * restrict pb, size_t num)
+{
+	TSR_ITEM *stop = pb + num, t;
+
+	TSR_MOVES(3 * num * sizeof(*pa), 3 * num * sizeof(*pa));
+
+	while (pb != stop)
+		t = *pa, *pa++ = *po, *po++ = *pb, *pb++ = t;
+} // ring_positive
+
+
+static inline void
+TSR_FN(ring_negative)(TSR_ITEM * restrict pa, TSR_ITEM * restrict po, TSR_ITEM * restrict pb, size_t num)
+{
+	TSR_ITEM *stop = pb - num, t;
+
+	TSR_MOVES(3 * num * sizeof(*pa), 3 * num * sizeof(*pa));
+
+	while (pb != stop)
+		t = *--pb, *pb = *--po, *po = *--pa, *pa = t;
+} // ring_negative
+
+#endif // TSR_KERNEL
+
+#ifndef TSR_MEMMOVE
+#define TSR_MEMMOVE(d, s, n)	memmove(d, s, n)
+#endif
+
+
+#ifdef TSR_STAGE_SIZE
+#define TSR_SMALL		TSR_KERNEL(stage_small)
+#define TSR_OVERLAP		TSR_KERNEL(stage_overlap)
+#define TSR_STAGE_ITEMS		(TSR_STAGE_SIZE / sizeof(TSR_ITEM))
+#else
+#define TSR_SMALL		TSR_FN(rotate_small)
+#define TSR_OVERLAP		TSR_FN(rotate_overlap)
+#define TSR_STAGE_ITEMS		(MIN_STREAM_SIZE / sizeof(TSR_ITEM))
+
+static void
+TSR_FN(rotate_small)(TSR_ITEM *pa, TSR_ITEM *pb, TSR_ITEM *pe)
+{
+	size_t	na = pb - pa, nb = pe - pb;
+	TSR_ITEM *pc = pa + nb;
+	char	_buf[STREAM_BUF_SIZE];
+	void	*buf = (void *)_buf;
+
+	if (na < nb) {
+		memcpy(buf, pa, na * sizeof(*pa));
+		TSR_MEMMOVE(pa, pb, nb * sizeof(*pa));
+		memcpy(pc, buf, na * sizeof(*pa));
+	} else {
+		memcpy(buf, pb, nb * sizeof(*pa));
+		TSR_MEMMOVE(pc, pa, na * sizeof(*pa));
+		memcpy(pa, buf, nb * sizeof(*pa));
+	}
+} // rotate_small
+
+
+static void
+TSR_FN(rotate_overlap)(TSR_ITEM *pa, TSR_ITEM *pb, TSR_ITEM *pe)
+{
+	size_t	na = pb - pa, nb = pe - pb;
+	char	_buf[STREAM_BUF_SIZE];
+	void	*buf = (void *)_buf;
+
+	if (na < nb) {
+		size_t	nc = nb - na;
+		TSR_ITEM *pc = pa + na, *pd = pc + na;
+
+		memcpy(buf, pd, nc * sizeof(*pa));
+		TSR_KERNEL(bridge_down)(pc, pd, pe, na);
+		memcpy(pc, buf, nc * sizeof(*pa));
+	} else {
+		size_t	nc = na - nb;
+		TSR_ITEM *pc = pa + nb, *pd = pc + nb;
+
+		memcpy(buf, pc, nc * sizeof(*pa));
+		TSR_KERNEL(bridge_up)(pa, pb, pc, nb);
+		memcpy(pd, buf, nc * sizeof(*pa));
+	}
+} // rotate_overlap
+
+#endif // TSR_STAGE_SIZE
+
+
+static void
+TSR_FN(triple_shift_rotate_v2)(TSR_ITEM *pa, size_t na, size_t nb)
+{
+	for (TSR_ITEM *pb = pa + na, *pe = pb + nb; na; nb = pe - pb, na = pb - pa) {
+		if (na < nb) {
+			size_t	no = nb - na;
+
+			if (na <= TSR_STAGE_ITEMS)
+				return TSR_SMALL(pa, pb, pe);
+
+			if (no <= TSR_STAGE_ITEMS)
+				return TSR_OVERLAP(pa, pb, pe);
+
+			for ( ; na > no; pa += no, na -= no)
+				TSR_KERNEL(ring_positive)(pa, pb, pe - na, no);
+
+			TSR_KERNEL(ring_positive)(pa, pb, pe - na, na);
+
+			pa = pb,  pe = pb + no,  pb += na;
+		} else if (na == nb) {
+			return TSR_KERNEL(two_way_swap_block)(pa, pb, na);
+		} else if (nb == 0) {
+			return;
+		} else {
+			size_t	no = na - nb;
+
+			if (nb <= TSR_STAGE_ITEMS)
+				return TSR_SMALL(pa, pb, pe);
+
+			if (no <= TSR_STAGE_ITEMS)
+				return TSR_OVERLAP(pa, pb, pe);
+
+			for ( ; nb > no; pe -= no, nb -= no)
+				TSR_KERNEL(ring_negative)(pa + nb, pb, pe, no);
+
+			TSR_KERNEL(ring_negative)(pa + nb, pb, pe, nb);
+
+			pe = pb,  pa = pb - no,  pb -= nb;
+		}
+	}
+} // triple_shift_rotate_v2
+
+
+#undef TSR_STAGE_ITEMS
+#undef TSR_STAGE_SIZE
+#undef TSR_OVERLAP
+#undef TSR_SMALL
+#undef TSR_MEMMOVE
+#undef TSR_KERNEL
+#undef TSR_FN
+#undef TSR_EXPAND
+#undef TSR_PASTE
+#undef TSR_SUFFIX
+#undef TSR_ITEM
@@ -54,10 +54,14 @@
 // a ~20% speed penalty.
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "triple-shift-rotate-moves.h"
+
 // At their core, both triple_shift_rotate() and triple_shift_rotate_v2() are
 // essentially using the overlap between any two blocks as an in-place buffer
 // to effectuate a streaming transfer of bytes when exchanging the two blocks
@@ -81,14 +85,84 @@
 // be set, which forces the algorithms to do all transfers in-place, which
 // naturally comes with a performance penalty for small item sizes in the
 // scenarios described above.
-#define MIN_STREAM_SIZE      1024
+//
+// The best value, along with the triple_reverse_rotate() crossover below, is
+// dependent upon the CPU that we're running on.  Both may be set without
+// editing this file, by defining TSR_MIN_STREAM_SIZE and TSR_REVERSE_CROSSOVER
+// before including it, or by setting TSR_CONFIG to the name of a header that
+// defines them.  `make tsr-config.h` measures the best values for the build
+// machine and writes them out to such a header, which is then used via:
+//
+//	cc -DTSR_CONFIG='"tsr-config.h"' ...
+#ifdef TSR_CONFIG
+#include TSR_CONFIG
+#endif
+
+// For stacks of only a few KB, such as those of coroutines and fibers, define
+// TSR_STACK_FREE.  This sets MIN_STREAM_SIZE to 0, so that nothing makes use
+// of a stack buffer.  The explicit SIMD rotations then still handle the small
+// block and small overlap cases quickly, by holding the small part in vector
+// registers instead.  See tsr_stage_small() in triple-shift-rotate-simd-template.h
+// The batched rotations of triple-shift-rotate-batch.h are not covered, as they
+// group their segments in arrays on the stack regardless
+#ifdef TSR_STACK_FREE
+#ifdef TSR_TUNABLE
+#error "TSR_STACK_FREE cannot be combined with TSR_TUNABLE"
+#endif
+#undef TSR_MIN_STREAM_SIZE
+#define TSR_MIN_STREAM_SIZE	0
+#endif
+
+#ifndef TSR_MIN_STREAM_SIZE
+#define TSR_MIN_STREAM_SIZE	1024
+#endif
+
+// The number of ITEMS at and above which triple_reverse_rotate() will reverse
+// the whole array from the middle outwards, instead of from the ends inwards
+#ifndef TSR_REVERSE_CROSSOVER
+#define TSR_REVERSE_CROSSOVER	60000
+#endif
+
+#ifdef TSR_TUNABLE
+// When TSR_TUNABLE is defined, the above become runtime variables instead, so
+// that they can be altered via tsr_tune_set() without recompiling.  This is
+// how the rotate test harness calibrates them.  The stack buffers are then
+// always TSR_MAX_STREAM_SIZE bytes, which caps the MIN_STREAM_SIZE that can
+// be set at runtime
+#ifndef TSR_MAX_STREAM_SIZE
+#define TSR_MAX_STREAM_SIZE	4096
+#endif
+
+static struct {
+	size_t	min_stream_size;
+	size_t	reverse_crossover;
+} tsr_tune = { TSR_MIN_STREAM_SIZE, TSR_REVERSE_CROSSOVER };
+
+// Sets the runtime tunables.  MIN_STREAM is capped at TSR_MAX_STREAM_SIZE
+static void
+tsr_tune_set(size_t min_stream, size_t reverse_crossover)
+{
+	if (min_stream > TSR_MAX_STREAM_SIZE)
+		min_stream = TSR_MAX_STREAM_SIZE;
+
+	tsr_tune.min_stream_size = min_stream;
+	tsr_tune.reverse_crossover = reverse_crossover;
+} // tsr_tune_set
+
+#define MIN_STREAM_SIZE		tsr_tune.min_stream_size
+#define STREAM_BUF_SIZE		TSR_MAX_STREAM_SIZE
+#define REVERSE_CROSSOVER	tsr_tune.reverse_crossover
+#else
+#define MIN_STREAM_SIZE		TSR_MIN_STREAM_SIZE
+#define REVERSE_CROSSOVER	TSR_REVERSE_CROSSOVER
 
-// This is done to prevent compiler complaints if SMALL_ROTATE_SIZE is set to 0
+// This is done to prevent compiler complaints if MIN_STREAM_SIZE is set to 0
 #if (MIN_STREAM_SIZE > 0)
 #define STREAM_BUF_SIZE MIN_STREAM_SIZE
 #else
 #define STREAM_BUF_SIZE 1
 #endif
+#endif
 
 //------------------------------------------------------------------------------
 //                  Generic Swap Block Function
@@ -101,6 +175,8 @@ two_way_swap_block(uintptr_t * restrict pa, uintptr_t * restrict pb, size_t num)
 {
 	uintptr_t *stop = pb + num, t;
 
+	TSR_MOVES(2 * num * sizeof(*pa), 2 * num * sizeof(*pa));
+
 	while (pb != stop)
 		t = *pa, *pa++ = *pb, *pb++ = t;
 } // two_way_swap_block
@@ -151,6 +227,8 @@ bridge_down(uintptr_t * restrict pc, uintptr_t *pd, uintptr_t *pe, size_t num)
 {
 	uintptr_t *stop = pc - num;
 
+	TSR_MOVES(2 * num * sizeof(*pc), 2 * num * sizeof(*pc));
+
 	while (pc != stop)
 		*--pe = *--pc, *pc = *--pd;
 } // bridge_down
@@ -161,6 +239,8 @@ bridge_up(uintptr_t * restrict pa, uintptr_t *pb, uintptr_t *pc, size_t num)
 {
 	uintptr_t *stop = pc + num;
 
+	TSR_MOVES(2 * num * sizeof(*pc), 2 * num * sizeof(*pc));
+
 	while (pc != stop)
 		*pc++ = *pa, *pa++ = *pb++;
 } // bridge_down
@@ -214,6 +294,8 @@ reverse_block_outwards(uintptr_t * restrict pa, uintptr_t * restrict pe)
 	size_t num = (pe - pa) >> 1;
 	uintptr_t *stop = pa, t;
 
+	TSR_MOVES(2 * num * sizeof(*pa), 2 * num * sizeof(*pa));
+
 	pa += num;
 	pe -= num;
 	while (pa != stop)
@@ -227,6 +309,8 @@ reverse_block(uintptr_t * restrict pa, uintptr_t * restrict pe)
 	size_t num = (pe - pa) >> 1;
 	uintptr_t *stop = pa + num, t;
 
+	TSR_MOVES(2 * num * sizeof(*pa), 2 * num * sizeof(*pa));
+
 	while (pa != stop)
 		t = *pa, *pa++ = *--pe, *pe = t;
 } // reverse_block
@@ -243,12 +327,16 @@ reverse_and_shift(uintptr_t * restrict pa, uintptr_t * restrict pc, size_t na)
 	uintptr_t * restrict pd = pc + na;
 	uintptr_t t;
 
+	TSR_MOVES(4 * (na >> 1) * sizeof(*pa), 4 * (na >> 1) * sizeof(*pa));
+
 	while (pa != stop)
 		t = *pa, *pa++ = *--pd, *pd = *--pb, *pb = *pc, *pc++ = t;
 
-	// Handle single straggler corner case
-	if (pa == pb)
+	// An odd sized block leaves its middle item behind, to swap on its own
+	if (pa != pb) {
+		TSR_MOVES(2 * sizeof(*pa), 2 * sizeof(*pa));
 		t = *pa, *pa = *pc, *pc = t;
+	}
 } // reverse_and_shift
 
 // Stew's optimised triple-reverse.  Typically 5-10% faster than a naive triple reverse
@@ -259,21 +347,23 @@ triple_reverse_rotate(uintptr_t *pa, size_t na, size_t nb)
 
 	// The "cross-over" point here is almost guaranteed to be
 	// CPU architecture dependent, and reliant upon the size
-	// of the CPU L1 cache.  We'll just use 60K items for now
-	if ((na + nb) < 60000) {
+	// of the CPU L1 cache.  See TSR_REVERSE_CROSSOVER
+	if ((na + nb) < REVERSE_CROSSOVER) {
 		reverse_block(pa, pe);
 	} else {
 		reverse_block_outwards(pa, pe);
 	}
 
-	// Unreversing the smaller block first is almost
-	// always faster due to CPU cache locality
+	// The blocks have now swapped places, so B starts at PA
+	// and A at PA + NB.  Unreversing the smaller block first
+	// is almost always faster due to CPU cache locality
+	pb = pa + nb;
 	if (na < nb) {
-		reverse_block(pa, pb);
 		reverse_block(pb, pe);
+		reverse_block(pa, pb);
 	} else {
-		reverse_block(pb, pe);
 		reverse_block(pa, pb);
+		reverse_block(pb, pe);
 	}
 } // triple_reverse_rotate
 
@@ -331,6 +421,8 @@ ring_positive(uintptr_t * restrict pa, uintptr_t * restrict po, uintptr_t * rest
 {
 	uintptr_t *stop = pb + num, t;
 
+	TSR_MOVES(3 * num * sizeof(*pa), 3 * num * sizeof(*pa));
+
 	while (pb != stop)
 		t = *pa, *pa++ = *po, *po++ = *pb, *pb++ = t;
 } // ring_positive
@@ -343,6 +435,8 @@ ring_negative(uintptr_t * restrict pa, uintptr_t * restrict po, uintptr_t * rest
 {
 	uintptr_t *stop = pb - num, t;
 
+	TSR_MOVES(3 * num * sizeof(*pa), 3 * num * sizeof(*pa));
+
 	while (pb != stop)
 		t = *--pb, *pb = *--po, *po = *--pa, *pa = t;
 } // ring_negative
@@ -424,6 +518,8 @@ three_way_swap_block(uintptr_t * restrict pa, uintptr_t * restrict pb,
 {
 	uintptr_t *stop = pb + num, t;
 
+	TSR_MOVES(3 * num * sizeof(*pa), 3 * num * sizeof(*pa));
+
 	while (pb != stop)
 		t = *pa, *pa++ = *pb, *pb++ = *pc, *pc++ = t;
 } // three_way_swap_block
@@ -517,10 +613,144 @@ old_forsort_rotate(uintptr_t *pa, size_t na, size_t nb)
 } // old_forsort_rotate
 
 
+//------------------------------------------------------------------------------
+//                  Item Size Generic Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Stamp out a copy of the V2 kernels for each of the native item widths.  This
+// produces triple_shift_rotate_v2_u8(), _u16(), _u32() and _u64()
+#define TSR_ITEM	uint8_t
+#define TSR_SUFFIX	_u8
+#include "triple-shift-rotate-template.h"
+
+#define TSR_ITEM	uint16_t
+#define TSR_SUFFIX	_u16
+#include "triple-shift-rotate-template.h"
+
+#define TSR_ITEM	uint32_t
+#define TSR_SUFFIX	_u32
+#include "triple-shift-rotate-template.h"
+
+#define TSR_ITEM	uint64_t
+#define TSR_SUFFIX	_u64
+#include "triple-shift-rotate-template.h"
+
+// Records that are a multiple of 16 or 32 bytes are moved in chunks of that
+// many bytes, rather than a uint64_t at a time.  Each chunk is copied whole,
+// which the compiler does through vector registers, so a 256 byte record is
+// swapped in eight moves rather than thirty two.  The chunks only need the
+// alignment of a uint64_t.  This produces triple_shift_rotate_v2_c16() and _c32()
+typedef struct { uint64_t q[2]; } tsr_chunk16_t;
+typedef struct { uint64_t q[4]; } tsr_chunk32_t;
+
+#define TSR_ITEM	tsr_chunk16_t
+#define TSR_SUFFIX	_c16
+#include "triple-shift-rotate-template.h"
+
+#define TSR_ITEM	tsr_chunk32_t
+#define TSR_SUFFIX	_c32
+#include "triple-shift-rotate-template.h"
+
+// Rotates NA items of SIZE bytes each at BASE with the NB items that follow.
+//
+// A rotation of items that are SIZE bytes wide is exactly the same operation
+// as a rotation of any smaller unit that evenly divides SIZE, where the block
+// lengths are scaled up by (SIZE / unit).  So 16 byte items are rotated as
+// pairs of uint64_t, and 24 byte records as triples of them, while a 3 byte
+// item has to drop all the way down to being rotated byte by byte.
+//
+// The widest unit that divides both SIZE and the alignment of BASE is chosen,
+// so that every unit access made by the kernels is naturally aligned.  Beyond
+// a uint64_t, the alignment stays at that of a uint64_t, and SIZE alone picks
+// the chunk.
+//
+// The rotate_small() and rotate_overlap() stack buffer is counted in units,
+// and every block that V2 works upon is a whole number of items, so the
+// buffer is only ever used for a whole number of items.  Records larger than
+// the buffer never use it, and are just rotated by the ring passes.
+static void
+triple_shift_rotate_v2_sized(void *base, size_t na, size_t nb, size_t size)
+{
+	size_t	align = (size_t)(uintptr_t)base | size;
+
+	if (((align & (sizeof(uint64_t) - 1)) == 0) && ((size % sizeof(tsr_chunk32_t)) == 0)) {
+		size /= sizeof(tsr_chunk32_t);
+		triple_shift_rotate_v2_c32(base, na * size, nb * size);
+	} else if (((align & (sizeof(uint64_t) - 1)) == 0) && ((size % sizeof(tsr_chunk16_t)) == 0)) {
+		size /= sizeof(tsr_chunk16_t);
+		triple_shift_rotate_v2_c16(base, na * size, nb * size);
+	} else if ((align & (sizeof(uint64_t) - 1)) == 0) {
+		size /= sizeof(uint64_t);
+		triple_shift_rotate_v2_u64(base, na * size, nb * size);
+	} else if ((align & (sizeof(uint32_t) - 1)) == 0) {
+		size /= sizeof(uint32_t);
+		triple_shift_rotate_v2_u32(base, na * size, nb * size);
+	} else if ((align & (sizeof(uint16_t) - 1)) == 0) {
+		size /= sizeof(uint16_t);
+		triple_shift_rotate_v2_u16(base, na * size, nb * size);
+	} else {
+		triple_shift_rotate_v2_u8(base, na * size, nb * size);
+	}
+} // triple_shift_rotate_v2_sized
+
+
+//------------------------------------------------------------------------------
+//                       Explicit SIMD Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Provides triple_shift_rotate_v2_simd() and triple_shift_rotate_v2_simd_sized()
+// which use hand written SSE2/AVX2/AVX-512 kernels chosen at load time
+#include "triple-shift-rotate-simd.h"
+
+
+//------------------------------------------------------------------------------
+//                      Multi-Threaded Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Provides triple_shift_rotate_v2_mt() which splits the ring passes of large
+// rotations across a persistent pool of worker threads
+#include "triple-shift-rotate-mt.h"
+
+
+//------------------------------------------------------------------------------
+//                          Batched Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Provides rotate_batch() for rotating many small independent segments at once
+#include "triple-shift-rotate-batch.h"
+
+
+//------------------------------------------------------------------------------
+//                   Scratch Buffered Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Provides triple_shift_rotate_v2_buf(), which uses a caller supplied buffer
+#include "triple-shift-rotate-buf.h"
+
+
+//------------------------------------------------------------------------------
+//                  Memory Mapped File Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Provides triple_shift_rotate_file(), which rotates a range of a file in place
+// upon a shared mapping of it
+#include "triple-shift-rotate-file.h"
+
+
+//------------------------------------------------------------------------------
+//                     Out-Of-Core Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// Provides triple_shift_rotate_stream(), which rotates a range of a file of
+// any size through a fixed size buffer with pread() and pwrite()
+#include "triple-shift-rotate-stream.h"
+
+
 //------------------------------------------------------------------------------
 //                              #define cleanup
 //------------------------------------------------------------------------------
 
 #undef MIN_STREAM_SIZE
 #undef STREAM_BUF_SIZE
+#undef REVERSE_CROSSOVER
 #undef SWAP
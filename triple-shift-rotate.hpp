@@ -0,0 +1,458 @@
+/*
+               Copyright (C) 2025 Stew Forster stew675@gmail.com
+*/
+
+/*
+        Permission is hereby granted, free of charge, to any person obtaining
+        a copy of this software and associated documentation files (the
+        "Software"), to deal in the Software without restriction, including
+        without limitation the rights to use, copy, modify, merge, publish,
+        distribute, sublicense, and/or sell copies of the Software, and to
+        permit persons to whom the Software is furnished to do so, subject to
+        the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+        THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+        EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+        MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+        IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+        CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+        TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+        SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//                         tsr::rotate() for C++
+//
+// A header-only C++ port of triple_shift_rotate_v2() from triple-shift-rotate.h
+// with the same interface as std::rotate():
+//
+//     auto it = tsr::rotate(first, middle, last);
+//
+// moves [middle, last) to the start of the range, and returns an iterator to
+// where *first ended up, being first + (last - middle).  Any random access
+// iterator may be used.
+//
+// When the iterators refer to contiguous memory and the item type is trivially
+// copyable, then the rotate_small() and rotate_overlap() helpers are engaged
+// using a MIN_STREAM_SIZE byte stack buffer with memcpy()/memmove(), exactly
+// as the C version does.  Raw pointers always count as contiguous, but other
+// iterators, std::vector's among them, only do from C++20 on, as that is when
+// std::contiguous_iterator arrived.  Before then, pass v.data() rather than
+// v.begin() to have a vector take this path.  For all other items, such as
+// std::string, and for iterators not known to be contiguous, the items are
+// moved about with std::move() and std::iter_swap() alone, and the in-place
+// ring passes handle every case.  This is the same as setting
+// MIN_STREAM_SIZE to 0 in the C version, and no item is ever copied.
+//
+// Where the sizes are known at compile time, such as for fixed size windows,
+//
+//     auto p = tsr::rotate<N, K>(first);
+//
+// rotates the N items at the pointer FIRST such that FIRST[K] becomes the first
+// item, the same as tsr::rotate(first, first + K, first + N).  Every size that
+// the V2 driver would test at runtime is then a constant, so its branches are
+// all resolved at compile time, and what is left is fixed length copies and
+// ring passes, with no loops other than within the ring passes themselves.
+
+#ifndef TRIPLE_SHIFT_ROTATE_HPP
+#define TRIPLE_SHIFT_ROTATE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// As with triple-shift-rotate.h, a calibrated TSR_MIN_STREAM_SIZE may be given
+// directly, or from the header named by TSR_CONFIG
+#ifdef TSR_CONFIG
+#include TSR_CONFIG
+#endif
+
+#ifndef TSR_MIN_STREAM_SIZE
+#define TSR_MIN_STREAM_SIZE	1024
+#endif
+
+namespace tsr {
+
+// See the discussion of MIN_STREAM_SIZE in triple-shift-rotate.h.  This is the
+// number of BYTES at or below which small and overlapping blocks are moved via
+// a stack buffer, when the items are trivially copyable
+constexpr std::size_t min_stream_size = TSR_MIN_STREAM_SIZE;
+
+// The size of that stack buffer, which can't be 0
+constexpr std::size_t stream_buf_size = (min_stream_size > 0) ? min_stream_size : 1;
+
+// tsr::rotate<N, K>() rotates up to this many BYTES of trivially copyable items
+// by copying the whole range out and back again.  With the size known, each
+// copy becomes a fixed run of vector loads and stores, with no branches at all
+constexpr std::size_t static_whole_size = 512;
+
+// tsr::rotate<N, K>() unrolls at most this many passes of the V2 driver loop,
+// and otherwise just calls the runtime driver
+constexpr std::size_t static_max_passes = 16;
+
+namespace detail {
+
+//------------------------------------------------------------------------------
+//                  Iterator Kernels (any item type)
+//------------------------------------------------------------------------------
+
+// Swaps NUM items at PA with NUM items at PB
+template <class It, class Diff>
+inline void
+two_way_swap_block(It pa, It pb, Diff num)
+{
+	for (It stop = pb + num; pb != stop; ++pa, ++pb)
+		std::iter_swap(pa, pb);
+} // two_way_swap_block
+
+
+// Left-rotates by 1 the 3 blocks of NUM items at PA, PO and PB.  PO is the
+// overlapping section that gets used as a ring buffer
+template <class It, class Diff>
+inline void
+ring_positive(It pa, It po, It pb, Diff num)
+{
+	for (It stop = pb + num; pb != stop; ++pa, ++po, ++pb) {
+		auto t = std::move(*pa);
+		*pa = std::move(*po);
+		*po = std::move(*pb);
+		*pb = std::move(t);
+	}
+} // ring_positive
+
+
+// Right-rotates by 1 the 3 blocks of NUM items that END at PA, PO and PB
+template <class It, class Diff>
+inline void
+ring_negative(It pa, It po, It pb, Diff num)
+{
+	for (It stop = pb - num; pb != stop; ) {
+		--pa, --po, --pb;
+		auto t = std::move(*pb);
+		*pb = std::move(*po);
+		*po = std::move(*pa);
+		*pa = std::move(t);
+	}
+} // ring_negative
+
+
+// Raw pointer overloads of the ring kernels.  The three blocks never overlap
+// within a single call, and saying so lets the compiler vectorise the loops
+// without runtime alias checks, as the restrict pointers do in the C version
+template <class T, class Diff>
+inline void
+ring_positive(T * __restrict pa, T * __restrict po, T * __restrict pb, Diff num)
+{
+	for (T *stop = pb + num; pb != stop; ) {
+		T t = std::move(*pa);
+		*pa++ = std::move(*po);
+		*po++ = std::move(*pb);
+		*pb++ = std::move(t);
+	}
+} // ring_positive
+
+
+template <class T, class Diff>
+inline void
+ring_negative(T * __restrict pa, T * __restrict po, T * __restrict pb, Diff num)
+{
+	for (T *stop = pb - num; pb != stop; ) {
+		T t = std::move(*--pb);
+		*pb = std::move(*--po);
+		*po = std::move(*--pa);
+		*pa = std::move(t);
+	}
+} // ring_negative
+
+
+//------------------------------------------------------------------------------
+//             Stack Buffered Helpers (trivially copyable items)
+//------------------------------------------------------------------------------
+
+// See rotate_small() in triple-shift-rotate.h
+template <class T>
+inline void
+rotate_small(T *pa, T *pb, T *pe)
+{
+	std::size_t na = pb - pa, nb = pe - pb;
+	T	*pc = pa + nb;
+	alignas(T) unsigned char buf[stream_buf_size];
+
+	if (na < nb) {
+		std::memcpy(buf, pa, na * sizeof(T));
+		std::memmove(pa, pb, nb * sizeof(T));
+		std::memcpy(pc, buf, na * sizeof(T));
+	} else {
+		std::memcpy(buf, pb, nb * sizeof(T));
+		std::memmove(pc, pa, na * sizeof(T));
+		std::memcpy(pa, buf, nb * sizeof(T));
+	}
+} // rotate_small
+
+
+// See bridge_down() in triple-shift-rotate.h
+template <class T>
+inline void
+bridge_down(T * __restrict pc, T *pd, T *pe, std::size_t num)
+{
+	for (T *stop = pc - num; pc != stop; )
+		*--pe = *--pc, *pc = *--pd;
+} // bridge_down
+
+
+// See bridge_up() in triple-shift-rotate.h
+template <class T>
+inline void
+bridge_up(T * __restrict pa, T *pb, T *pc, std::size_t num)
+{
+	for (T *stop = pc + num; pc != stop; )
+		*pc++ = *pa, *pa++ = *pb++;
+} // bridge_up
+
+
+// See rotate_overlap() in triple-shift-rotate.h
+template <class T>
+inline void
+rotate_overlap(T *pa, T *pb, T *pe)
+{
+	std::size_t na = pb - pa, nb = pe - pb;
+	alignas(T) unsigned char buf[stream_buf_size];
+
+	if (na < nb) {
+		std::size_t nc = nb - na;
+		T	*pc = pa + na, *pd = pc + na;
+
+		std::memcpy(buf, pd, nc * sizeof(T));
+		bridge_down(pc, pd, pe, na);
+		std::memcpy(pc, buf, nc * sizeof(T));
+	} else {
+		std::size_t nc = na - nb;
+		T	*pc = pa + nb, *pd = pc + nb;
+
+		std::memcpy(buf, pc, nc * sizeof(T));
+		bridge_up(pa, pb, pc, nb);
+		std::memcpy(pd, buf, nc * sizeof(T));
+	}
+} // rotate_overlap
+
+
+//------------------------------------------------------------------------------
+//                           Triple Shift Rotate V2
+//------------------------------------------------------------------------------
+
+// The V2 driver.  BUFFERED selects whether the stack buffered helpers may be
+// used, which requires PA to be a T* for a trivially copyable T.  The number
+// of items at or below which the helpers are engaged is min_items
+template <bool Buffered, class It>
+void
+triple_shift_rotate_v2(It pa, It pb, It pe)
+{
+	using Diff = typename std::iterator_traits<It>::difference_type;
+	using T = typename std::iterator_traits<It>::value_type;
+
+	constexpr Diff min_items = Buffered ? Diff(min_stream_size / sizeof(T)) : 0;
+
+	for (Diff na = pb - pa, nb = pe - pb; na; nb = pe - pb, na = pb - pa) {
+		if (na < nb) {
+			Diff	no = nb - na;
+
+			if constexpr (Buffered) {
+				if (na <= min_items)
+					return rotate_small(pa, pb, pe);
+
+				if (no <= min_items)
+					return rotate_overlap(pa, pb, pe);
+			}
+
+			for ( ; na > no; pa += no, na -= no)
+				ring_positive(pa, pb, pe - na, no);
+
+			ring_positive(pa, pb, pe - na, na);
+
+			pa = pb,  pe = pb + no,  pb += na;
+		} else if (na == nb) {
+			return two_way_swap_block(pa, pb, na);
+		} else if (nb == 0) {
+			return;
+		} else {
+			Diff	no = na - nb;
+
+			if constexpr (Buffered) {
+				if (nb <= min_items)
+					return rotate_small(pa, pb, pe);
+
+				if (no <= min_items)
+					return rotate_overlap(pa, pb, pe);
+			}
+
+			for ( ; nb > no; pe -= no, nb -= no)
+				ring_negative(pa + nb, pb, pe, no);
+
+			ring_negative(pa + nb, pb, pe, nb);
+
+			pe = pb,  pa = pb - no,  pb -= nb;
+		}
+	}
+} // triple_shift_rotate_v2
+
+
+// True if It is known to refer to contiguous memory
+template <class It>
+constexpr bool
+is_contiguous()
+{
+#if defined(__cpp_lib_concepts) && (__cpp_lib_concepts >= 202002L)
+	return std::contiguous_iterator<It>;
+#else
+	return std::is_pointer<It>::value;
+#endif
+} // is_contiguous
+
+
+//------------------------------------------------------------------------------
+//                       Compile-Time Sized Rotations
+//------------------------------------------------------------------------------
+
+// The number of passes of the V2 driver loop that a rotation of NA items with
+// NB items takes, when neither of the stack buffered helpers is used
+constexpr std::size_t
+static_passes(std::size_t na, std::size_t nb)
+{
+	std::size_t passes = 0;
+
+	for ( ; (na != nb) && na && nb; passes++) {
+		if (na < nb) {
+			std::size_t no = nb - na, nf = na - ((na - 1) / no) * no;
+
+			na = nf, nb = no - nf;
+		} else {
+			std::size_t no = na - nb, nf = nb - ((nb - 1) / no) * no;
+
+			na = no - nf, nb = nf;
+		}
+	}
+
+	return passes;
+} // static_passes
+
+
+// The inner loop of a positive pass of the V2 driver, unrolled.  Each of the
+// I'th ring passes is of NO items, as na shrinks by NO each time
+template <std::size_t NA, std::size_t NB, std::size_t NO, class T, std::size_t... I>
+inline void
+static_rings_positive(T *pa, std::index_sequence<I...>)
+{
+	(ring_positive(pa + I * NO, pa + NA, pa + NB + I * NO, NO), ...);
+} // static_rings_positive
+
+
+// The inner loop of a negative pass of the V2 driver, unrolled.  Here nb, and
+// the end of the range, shrink by NO each time instead
+template <std::size_t NA, std::size_t NB, std::size_t NO, class T, std::size_t... I>
+inline void
+static_rings_negative(T *pa, std::index_sequence<I...>)
+{
+	(ring_negative(pa + NB - I * NO, pa + NA, pa + NA + NB - I * NO, NO), ...);
+} // static_rings_negative
+
+
+// The V2 driver, with the loop turned into recursion upon the sizes that each
+// pass leaves behind, so that every size within it is a constant
+template <std::size_t NA, std::size_t NB, class T>
+inline void
+static_v2(T *pa)
+{
+	constexpr bool buffered = std::is_trivially_copyable<T>::value;
+	constexpr std::size_t min_items = buffered ? (min_stream_size / sizeof(T)) : 0;
+
+	if constexpr ((NA == 0) || (NB == 0)) {
+		return;
+	} else if constexpr (buffered && (((NA + NB) * sizeof(T)) <= static_whole_size)) {
+		alignas(T) unsigned char buf[(NA + NB) * sizeof(T)];
+
+		std::memcpy(buf, pa, (NA + NB) * sizeof(T));
+		std::memcpy(pa, buf + NA * sizeof(T), NB * sizeof(T));
+		std::memcpy(pa + NB, buf, NA * sizeof(T));
+	} else if constexpr (NA == NB) {
+		two_way_swap_block(pa, pa + NA, NA);
+	} else if constexpr (std::min(NA, NB) <= min_items) {
+		rotate_small(pa, pa + NA, pa + NA + NB);
+	} else if constexpr (std::max(NA, NB) - std::min(NA, NB) <= min_items) {
+		rotate_overlap(pa, pa + NA, pa + NA + NB);
+	} else if constexpr (static_passes(NA, NB) > static_max_passes) {
+		triple_shift_rotate_v2<buffered>(pa, pa + NA, pa + NA + NB);
+	} else if constexpr (NA < NB) {
+		constexpr std::size_t NO = NB - NA, K = (NA - 1) / NO, NF = NA - K * NO;
+
+		static_rings_positive<NA, NB, NO>(pa, std::make_index_sequence<K>());
+		ring_positive(pa + K * NO, pa + NA, pa + NB + K * NO, NF);
+
+		static_v2<NF, NO - NF>(pa + NA);
+	} else {
+		constexpr std::size_t NO = NA - NB, K = (NB - 1) / NO, NF = NB - K * NO;
+
+		static_rings_negative<NA, NB, NO>(pa, std::make_index_sequence<K>());
+		ring_negative(pa + NF, pa + NA, pa + NA + NB - K * NO, NF);
+
+		static_v2<NO - NF, NF>(pa + NB);
+	}
+} // static_v2
+
+} // namespace detail
+
+
+// Rotates [FIRST, LAST) such that MIDDLE becomes the first item.  Returns the
+// new position of the item that was originally at FIRST
+template <class It>
+It
+rotate(It first, It middle, It last)
+{
+	using T = typename std::iterator_traits<It>::value_type;
+
+	static_assert(std::is_base_of<std::random_access_iterator_tag,
+	              typename std::iterator_traits<It>::iterator_category>::value,
+	              "tsr::rotate() requires random access iterators");
+
+	if (first == middle)
+		return last;
+
+	if (middle == last)
+		return first;
+
+	It	result = first + (last - middle);
+
+	if constexpr (detail::is_contiguous<It>() && std::is_trivially_copyable<T>::value) {
+		T	*pa = std::addressof(*first);
+
+		detail::triple_shift_rotate_v2<true>(pa, pa + (middle - first), pa + (last - first));
+	} else {
+		detail::triple_shift_rotate_v2<false>(first, middle, last);
+	}
+
+	return result;
+} // rotate
+
+
+// Rotates the N items at FIRST such that FIRST[K] becomes the first item, with
+// both N and K known at compile time.  Returns the new position of the item
+// that was originally at FIRST, being FIRST + (N - K)
+template <std::size_t N, std::size_t K, class T>
+inline T *
+rotate(T *first)
+{
+	static_assert(K <= N, "tsr::rotate<N, K>() requires K <= N");
+
+	detail::static_v2<K, N - K>(first);
+
+	return first + (N - K);
+} // rotate
+
+} // namespace tsr
+
+#endif // TRIPLE_SHIFT_ROTATE_HPP